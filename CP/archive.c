@@ -0,0 +1,425 @@
+#include "archive.h"
+#include "log.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define ARCHIVE_PATH_SIZE 512
+#define RECORD_MAX                                                            \
+  (2 + 13 + MAX_PLAYERS * MAX_PLAYER_NAME + 2 * MAX_PLAYERS * MAX_SHIPS + 1 + \
+   ARCHIVE_MAX_MOVES * ARCHIVE_MOVE_BYTES + 4)
+
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+} Buffer;
+
+static struct {
+  bool enabled;
+  char dir[ARCHIVE_PATH_SIZE];
+  int fd;
+  uint32_t seq;
+  size_t written; // байт в текущем сегменте
+
+  pthread_mutex_t lock;
+  Buffer pending; // записи, ещё не отданные потоку архива
+  bool stopping;  // под lock
+  bool started;
+  pthread_t thread;
+} archive = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+// FNV-1a
+static uint32_t checksum(const uint8_t *data, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static bool buffer_put(Buffer *b, const uint8_t *data, size_t len) {
+  if (b->len + len > b->cap) {
+    size_t cap = b->cap ? b->cap * 2 : 65536;
+    while (cap < b->len + len) {
+      cap *= 2;
+    }
+    uint8_t *grown = realloc(b->data, cap);
+    if (grown == NULL) {
+      return false;
+    }
+    b->data = grown;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  return true;
+}
+
+static void put_u32(uint8_t *out, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+  return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 |
+         (uint32_t)in[3] << 24;
+}
+
+static void put_u64(uint8_t *out, uint64_t v) {
+  put_u32(out, (uint32_t)v);
+  put_u32(out + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_u64(const uint8_t *in) {
+  return (uint64_t)get_u32(in) | (uint64_t)get_u32(in + 4) << 32;
+}
+
+// Ходы партии
+
+void archive_game_started(Game *game, uint32_t tick) {
+  if (!archive.enabled || game->log != NULL) {
+    return;
+  }
+  GameLog *history = malloc(sizeof(GameLog));
+  if (history == NULL) {
+    log_error("Archive: no memory for game %d", game->id);
+    return;
+  }
+  history->started = (uint32_t)time(NULL);
+  history->last_tick = tick;
+  history->count = 0;
+  history->len = 0;
+  game->log = history;
+}
+
+void archive_shot(Game *game, int x, int y, ShotResult result, uint32_t tick) {
+  GameLog *history = game->log;
+  if (history == NULL || history->count == ARCHIVE_MAX_MOVES) {
+    return;
+  }
+  uint32_t delta = tick - history->last_tick;
+  history->last_tick = tick;
+
+  uint32_t escape =
+      delta < ARCHIVE_DELTA_ESCAPE ? delta : ARCHIVE_DELTA_ESCAPE;
+  uint16_t move =
+      (uint16_t)((y * BOARD_SIZE + x) | (uint32_t)result << 7 | escape << 9);
+  uint8_t *out = history->moves + history->len;
+  *out++ = (uint8_t)move;
+  *out++ = (uint8_t)(move >> 8);
+  if (escape == ARCHIVE_DELTA_ESCAPE) {
+    while (delta >= 0x80) {
+      *out++ = (uint8_t)(delta | 0x80);
+      delta >>= 7;
+    }
+    *out++ = (uint8_t)delta;
+  }
+  history->len = (size_t)(out - history->moves);
+  history->count++;
+}
+
+// Флот в порядке fleet_sizes, если состав стандартный: 10 байт вместо 20
+static bool standard_fleet(const Board *board, uint8_t fleet[MAX_SHIPS]) {
+  bool used[MAX_SHIPS] = {false};
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int found = -1;
+    for (int j = 0; j < board->ship_count && found < 0; j++) {
+      int size;
+      uint8_t ship = board_ship(board, j, &size);
+      if (!used[j] && size == fleet_sizes[i]) {
+        found = j;
+        fleet[i] = ship;
+      }
+    }
+    if (found < 0) {
+      return false;
+    }
+    used[found] = true;
+  }
+  return true;
+}
+
+static size_t put_str(uint8_t *out, const char *s, size_t cap) {
+  size_t len = strnlen(s, cap - 1);
+  out[0] = (uint8_t)len;
+  memcpy(out + 1, s, len);
+  return len + 1;
+}
+
+void archive_game_over(Game *game, int winner, bool timeout) {
+  GameLog *history = game->log;
+  game->log = NULL;
+  if (history == NULL || winner < 0 || history->count == 0) {
+    free(history);
+    return;
+  }
+
+  uint8_t fleets[MAX_PLAYERS][MAX_SHIPS];
+  bool custom = false;
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    custom = custom || !standard_fleet(&game->boards[i], fleets[i]);
+  }
+
+  uint8_t record[RECORD_MAX];
+  uint8_t *out = record + 2;
+  put_u64(out, (uint64_t)game->id);
+  put_u32(out + 8, history->started);
+  out[12] = (uint8_t)((winner == 1 ? ARCHIVE_WINNER : 0) |
+                     (timeout ? ARCHIVE_TIMEOUT : 0) |
+                     (custom ? ARCHIVE_CUSTOM_FLEET : 0));
+  out += 13;
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    out += put_str(out, game->players[i], MAX_PLAYER_NAME);
+  }
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    const Board *board = &game->boards[i];
+    for (int j = 0; j < MAX_SHIPS; j++) {
+      if (custom) {
+        int size;
+        *out++ = board_ship(board, j, &size);
+        *out++ = (uint8_t)size;
+      } else {
+        *out++ = fleets[i][j];
+      }
+    }
+  }
+  *out++ = (uint8_t)history->count;
+  memcpy(out, history->moves, history->len);
+  out += history->len;
+  free(history);
+
+  size_t body = (size_t)(out - record - 2);
+  record[0] = (uint8_t)body;
+  record[1] = (uint8_t)(body >> 8);
+  put_u32(out, checksum(record + 2, body));
+  out += 4;
+
+  pthread_mutex_lock(&archive.lock);
+  bool ok = buffer_put(&archive.pending, record, (size_t)(out - record));
+  pthread_mutex_unlock(&archive.lock);
+  if (!ok) {
+    log_error("Archive: out of memory, game %d dropped", game->id);
+  }
+}
+
+// Чтение
+
+bool archive_segment_valid(const uint8_t *data, size_t len) {
+  return len >= ARCHIVE_HEADER_SIZE && get_u32(data) == ARCHIVE_MAGIC &&
+         get_u32(data + 4) == ARCHIVE_VERSION;
+}
+
+bool archive_next(const uint8_t *data, size_t len, size_t *pos,
+                  const uint8_t **body, size_t *body_len) {
+  size_t at = *pos;
+  if (at + 6 > len) {
+    return false;
+  }
+  size_t size = (size_t)data[at] | (size_t)data[at + 1] << 8;
+  if (at + 6 + size > len ||
+      checksum(data + at + 2, size) != get_u32(data + at + 2 + size)) {
+    return false;
+  }
+  *body = data + at + 2;
+  *body_len = size;
+  *pos = at + 6 + size;
+  return true;
+}
+
+bool archive_decode(const uint8_t *body, size_t len, ArchiveGame *game) {
+  const uint8_t *p = body, *end = body + len;
+  if (len < 13) {
+    return false;
+  }
+  game->game_id = (int64_t)get_u64(p);
+  game->started = get_u32(p + 8);
+  game->outcome = p[12];
+  p += 13;
+
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    size_t n = p < end ? *p++ : MAX_PLAYER_NAME;
+    if (n >= MAX_PLAYER_NAME || n > (size_t)(end - p)) {
+      return false;
+    }
+    memcpy(game->players[i], p, n);
+    game->players[i][n] = '\0';
+    p += n;
+  }
+
+  bool custom = game->outcome & ARCHIVE_CUSTOM_FLEET;
+  size_t fleet_bytes = (custom ? 2 : 1) * MAX_PLAYERS * MAX_SHIPS;
+  if ((size_t)(end - p) < fleet_bytes + 1) {
+    return false;
+  }
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    for (int j = 0; j < MAX_SHIPS; j++) {
+      game->ships[i][j] = *p++;
+      game->sizes[i][j] = custom ? *p++ : (uint8_t)fleet_sizes[j];
+    }
+  }
+
+  game->move_count = *p++;
+  if (game->move_count > ARCHIVE_MAX_MOVES) {
+    return false;
+  }
+  for (int i = 0; i < game->move_count; i++) {
+    if (end - p < 2) {
+      return false;
+    }
+    uint16_t move = (uint16_t)(p[0] | p[1] << 8);
+    p += 2;
+    ArchiveMove *m = &game->moves[i];
+    m->cell = move & 0x7f;
+    m->result = (move >> 7) & 0x3;
+    m->delta = move >> 9;
+    if (m->delta == ARCHIVE_DELTA_ESCAPE) {
+      m->delta = 0;
+      for (int shift = 0;; shift += 7) {
+        if (p == end || shift > 28) {
+          return false;
+        }
+        uint8_t b = *p++;
+        m->delta |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+          break;
+      }
+    }
+  }
+  return p == end;
+}
+
+// Файлы
+
+static bool write_all(int fd, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+// Следующий сегмент; предыдущий уже на диске целиком
+static bool open_segment(void) {
+  char path[ARCHIVE_PATH_SIZE + 32];
+  snprintf(path, sizeof(path), "%s/replays-%08u.bin", archive.dir,
+           archive.seq + 1);
+  int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+  uint8_t header[ARCHIVE_HEADER_SIZE];
+  put_u32(header, ARCHIVE_MAGIC);
+  put_u32(header + 4, ARCHIVE_VERSION);
+  if (fd < 0 || !write_all(fd, header, sizeof(header))) {
+    log_error("Archive: cannot create %s: %s", path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+
+  if (archive.fd >= 0) {
+    fdatasync(archive.fd);
+    close(archive.fd);
+  }
+  archive.fd = fd;
+  archive.seq++;
+  archive.written = sizeof(header);
+  return true;
+}
+
+bool archive_open(const char *dir) {
+  snprintf(archive.dir, sizeof(archive.dir), "%s", dir);
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Archive: cannot create %s: %s\n", dir, strerror(errno));
+    return false;
+  }
+
+  // Новый сегмент после последнего существующего
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    fprintf(stderr, "Archive: cannot open %s: %s\n", dir, strerror(errno));
+    return false;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    unsigned seq;
+    if (sscanf(entry->d_name, "replays-%8u.bin", &seq) == 1 &&
+        seq > archive.seq) {
+      archive.seq = seq;
+    }
+  }
+  closedir(d);
+
+  if (!open_segment()) {
+    return false;
+  }
+  archive.enabled = true;
+  return true;
+}
+
+static void *archive_main(void *arg) {
+  (void)arg;
+  Buffer batch = {0};
+  bool failed = false;
+  bool stop = false;
+
+  while (!stop) {
+    usleep(ARCHIVE_FLUSH_MS * 1000);
+
+    pthread_mutex_lock(&archive.lock);
+    stop = archive.stopping;
+    Buffer swap = archive.pending;
+    archive.pending = batch;
+    batch = swap;
+    pthread_mutex_unlock(&archive.lock);
+
+    if (batch.len == 0)
+      continue;
+
+    if (!write_all(archive.fd, batch.data, batch.len)) {
+      if (!failed) {
+        log_error("Archive: write failed: %s", strerror(errno));
+      }
+      failed = true;
+    }
+    archive.written += batch.len;
+    batch.len = 0;
+
+    if (archive.written >= ARCHIVE_SEGMENT_BYTES) {
+      open_segment();
+    }
+  }
+
+  fdatasync(archive.fd);
+  free(batch.data);
+  return NULL;
+}
+
+bool archive_start(void) {
+  if (!archive.enabled ||
+      pthread_create(&archive.thread, NULL, archive_main, NULL) != 0) {
+    return false;
+  }
+  archive.started = true;
+  return true;
+}
+
+void archive_stop(void) {
+  if (!archive.started) {
+    return;
+  }
+  pthread_mutex_lock(&archive.lock);
+  archive.stopping = true;
+  pthread_mutex_unlock(&archive.lock);
+  pthread_join(archive.thread, NULL);
+  archive.started = false;
+}
@@ -0,0 +1,90 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "common.h"
+
+// Архив сыгранных партий для проверки движка, статистики и регрессионных
+// прогонов (seabattle_replay).
+//
+// Воркер с начала партии копит её ходы в GameLog, в конце партии
+// собирает запись и отдаёт её потоку архива через общий буфер. Поток
+// раз в ARCHIVE_FLUSH_MS дописывает накопленное в текущий сегмент
+// replays-<номер>.bin; сегмент больше ARCHIVE_SEGMENT_BYTES закрывается
+// и начинается следующий. Сегменты только дописываются, каждый запуск
+// сервера открывает новый.
+//
+// Сегмент: [магия "SBRP":4][версия:4], затем записи
+// [длина тела:2][тело][контрольная сумма тела:4]. Тело:
+//   game_id:8, начало партии (секунды UNIX):4, исход:1, логины игроков
+//   ([длина:1][байты]), флоты обоих игроков, число ходов:1, ходы.
+// Исход: номер победителя и флаги ARCHIVE_*. Флот - 10 байт в порядке
+// fleet_sizes (как в MSG_PLACE_FLEET); с ARCHIVE_CUSTOM_FLEET - пары
+// [корабль][размер] в порядке расстановки. Ход - 2 байта little-endian:
+// клетка (7 бит), результат (2 бита), время с прошлого хода в тиках
+// TIMER_TICK_MS (7 бит); 127 - время не поместилось и идёт следом
+// varint'ом. Стреляет игрок 0, после промаха ход переходит.
+//
+// Пишутся только партии, которые дошли до выстрелов и закончились на
+// этом запуске: ходы партий, продолженных после перезапуска, не
+// сохранились.
+#define ARCHIVE_DEFAULT_DIR "seabattle-replays"
+#define ARCHIVE_FLUSH_MS 100
+#define ARCHIVE_SEGMENT_BYTES (64u << 20)
+#define ARCHIVE_MAGIC 0x50524253u // "SBRP"
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_HEADER_SIZE 8
+
+#define ARCHIVE_WINNER 0x01       // победил игрок 1
+#define ARCHIVE_TIMEOUT 0x02      // проигравший не уложился в срок хода
+#define ARCHIVE_CUSTOM_FLEET 0x04 // корабли ставились по одному
+
+#define ARCHIVE_MAX_MOVES (2 * BOARD_SIZE * BOARD_SIZE - 1)
+#define ARCHIVE_MOVE_BYTES 7 // 2 байта и varint до 5 байт
+#define ARCHIVE_DELTA_ESCAPE 127
+
+typedef struct GameLog {
+  uint32_t started;   // секунды UNIX
+  uint32_t last_tick; // тик последнего хода или начала партии
+  int count;
+  size_t len;
+  uint8_t moves[ARCHIVE_MAX_MOVES * ARCHIVE_MOVE_BYTES];
+} GameLog;
+
+typedef struct {
+  uint8_t cell;
+  uint8_t result; // ShotResult
+  uint32_t delta; // тики с прошлого хода
+} ArchiveMove;
+
+// Разобранная запись
+typedef struct {
+  int64_t game_id;
+  uint32_t started;
+  uint8_t outcome;
+  char players[MAX_PLAYERS][MAX_PLAYER_NAME];
+  uint8_t ships[MAX_PLAYERS][MAX_SHIPS]; // корабли в формате флота
+  uint8_t sizes[MAX_PLAYERS][MAX_SHIPS];
+  int move_count;
+  ArchiveMove moves[ARCHIVE_MAX_MOVES];
+} ArchiveGame;
+
+// Создаёт каталог и новый сегмент; без вызова архив выключен
+bool archive_open(const char *dir);
+bool archive_start(void);
+// Дописывает накопленное и закрывает сегмент
+void archive_stop(void);
+
+// Ходы партии. tick - текущий тик таймеров воркера. Без archive_open
+// ничего не делают; archive_game_over освобождает журнал ходов.
+void archive_game_started(Game *game, uint32_t tick);
+void archive_shot(Game *game, int x, int y, ShotResult result, uint32_t tick);
+void archive_game_over(Game *game, int winner, bool timeout);
+
+// Чтение. archive_next отдаёт тело записи с позиции *pos сегмента и
+// сдвигает позицию; false - конец или повреждённая запись.
+bool archive_segment_valid(const uint8_t *data, size_t len);
+bool archive_next(const uint8_t *data, size_t len, size_t *pos,
+                  const uint8_t **body, size_t *body_len);
+bool archive_decode(const uint8_t *body, size_t len, ArchiveGame *game);
+
+#endif // ARCHIVE_H
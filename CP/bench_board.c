@@ -0,0 +1,342 @@
+// Микробенчмарк игрового поля: расстановка, выстрелы и проверка конца
+// игры на старых досках int[10][10] и на битовых масках, случайный флот.
+#include "common.h"
+#include <time.h>
+
+#define ROUNDS 20000
+#define SNAPSHOTS 1024
+
+static const int fleet[MAX_SHIPS] = {4, 3, 3, 2, 2, 2, 1, 1, 1, 1};
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t next_rand(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Старая реализация из common.c - для сравнения
+
+// Проверка валидности размещения корабля
+static bool legacy_is_valid_placement(int board[BOARD_SIZE][BOARD_SIZE],
+                                      int x, int y, int size, int horizontal) {
+  if (x < 0 || y < 0)
+    return false;
+
+  if (horizontal == 1) {
+    if (x + size > BOARD_SIZE)
+      return false;
+
+    for (int row = y - 1; row <= y + 1; row++) {
+      for (int col = x - 1; col <= x + size; col++) {
+        if (row >= 0 && row < BOARD_SIZE && col >= 0 && col < BOARD_SIZE) {
+          if (board[row][col] == 1) {
+            // printf("h conflict at %d %d\n", row, col);
+            return false;
+          }
+        }
+      }
+    }
+  } else {
+    if (y + size > BOARD_SIZE)
+      return false;
+
+    for (int row = y - 1; row <= y + size; row++) {
+      for (int col = x - 1; col <= x + 1; col++) {
+        if (row >= 0 && row < BOARD_SIZE && col >= 0 && col < BOARD_SIZE) {
+          if (board[row][col] == 1) {
+            // printf("nh conflict at %d %d", row, col);
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+// Размещение корабля
+static bool legacy_place_ship(int board[BOARD_SIZE][BOARD_SIZE], int x, int y,
+                              int size, int horizontal) {
+  if (!legacy_is_valid_placement(board, x, y, size, horizontal)) {
+    return false;
+  }
+
+  if (horizontal == 1) {
+    for (int i = 0; i < size; i++) {
+      board[y][x + i] = 1;
+    }
+  } else {
+    for (int i = 0; i < size; i++) {
+      board[y + i][x] = 1;
+    }
+  }
+
+  return true;
+}
+
+// Выстрел
+static ShotResult legacy_make_shot(int board[BOARD_SIZE][BOARD_SIZE],
+                                   int shots[BOARD_SIZE][BOARD_SIZE], int x,
+                                   int y) {
+  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+    return SHOT_INVALID;
+  }
+
+  if (shots[x][y] != 0) {
+    return SHOT_INVALID;
+  }
+
+  if (board[x][y] == 1) {
+    shots[x][y] = 1;
+    board[x][y] = 3; // Помечаем как попадание
+
+    // Проверяем, потоплен ли корабль
+    bool sunk = true;
+    // Проверяем все клетки вокруг
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        int nx = x + dx;
+        int ny = y + dy;
+        if (nx >= 0 && nx < BOARD_SIZE && ny >= 0 && ny < BOARD_SIZE) {
+          if (board[nx][ny] == 1) {
+            sunk = false;
+            break;
+          }
+        }
+      }
+      if (!sunk)
+        break;
+    }
+
+    // Более точная проверка: ищем все клетки корабля
+    if (sunk) {
+      // Проверяем горизонтальное направление
+      for (int i = x - 1; i >= 0 && board[i][y] != 0 && board[i][y] != 2; i--) {
+        if (board[i][y] == 1) {
+          sunk = false;
+          break;
+        }
+      }
+      for (int i = x + 1;
+           i < BOARD_SIZE && board[i][y] != 0 && board[i][y] != 2; i++) {
+        if (board[i][y] == 1) {
+          sunk = false;
+          break;
+        }
+      }
+      // Проверяем вертикальное направление
+      for (int j = y - 1; j >= 0 && board[x][j] != 0 && board[x][j] != 2; j--) {
+        if (board[x][j] == 1) {
+          sunk = false;
+          break;
+        }
+      }
+      for (int j = y + 1;
+           j < BOARD_SIZE && board[x][j] != 0 && board[x][j] != 2; j++) {
+        if (board[x][j] == 1) {
+          sunk = false;
+          break;
+        }
+      }
+    }
+
+    return sunk ? SHOT_SUNK : SHOT_HIT;
+  } else {
+    shots[x][y] = 2;
+    board[x][y] = 2; // Помечаем как промах
+    return SHOT_MISS;
+  }
+}
+
+// Проверка окончания игры
+static bool legacy_check_game_over(int board[BOARD_SIZE][BOARD_SIZE]) {
+  for (int i = 0; i < BOARD_SIZE; i++) {
+    for (int j = 0; j < BOARD_SIZE; j++) {
+      if (board[i][j] == 1) {
+        return false; // Есть непотопленные корабли
+      }
+    }
+  }
+  return true; // Все корабли потоплены
+}
+
+// Случайная расстановка, как в auto_place_ships: попытки до успеха
+static int legacy_fleet(int board[BOARD_SIZE][BOARD_SIZE], uint32_t *seed) {
+  int attempts = 0;
+  memset(board, 0, sizeof(int) * BOARD_SIZE * BOARD_SIZE);
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int placed = 0;
+    while (!placed) {
+      uint32_t r = next_rand(seed);
+      placed = legacy_place_ship(board, r % BOARD_SIZE, (r >> 8) % BOARD_SIZE,
+                                 fleet[i], (r >> 16) & 1);
+      attempts++;
+      if (attempts > 10000) { // тупиковая расстановка, начинаем заново
+        memset(board, 0, sizeof(int) * BOARD_SIZE * BOARD_SIZE);
+        i = -1;
+        break;
+      }
+    }
+  }
+  return attempts;
+}
+
+static int bitboard_fleet(Board *board, uint32_t *seed) {
+  int attempts = 0;
+  board_clear(board);
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int placed = 0;
+    while (!placed) {
+      uint32_t r = next_rand(seed);
+      placed = board_place_ship(board, r % BOARD_SIZE, (r >> 8) % BOARD_SIZE,
+                                fleet[i], (r >> 16) & 1);
+      attempts++;
+      if (attempts > 10000) {
+        board_clear(board);
+        i = -1;
+        break;
+      }
+    }
+  }
+  return attempts;
+}
+
+static void shuffle(int *cells, uint32_t *seed) {
+  for (int i = BOARD_SIZE * BOARD_SIZE - 1; i > 0; i--) {
+    int j = next_rand(seed) % (i + 1);
+    int tmp = cells[i];
+    cells[i] = cells[j];
+    cells[j] = tmp;
+  }
+}
+
+int main(void) {
+  static int boards[ROUNDS][BOARD_SIZE][BOARD_SIZE];
+  static Board bitboards[ROUNDS];
+  static int shots[BOARD_SIZE][BOARD_SIZE];
+  long checksum = 0;
+
+  // Расстановка: одна и та же последовательность случайных попыток
+  uint32_t seed = 12345;
+  long attempts = 0;
+  double start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    attempts += legacy_fleet(boards[r], &seed);
+  }
+  double legacy_place = (now_ns() - start) / attempts;
+
+  seed = 12345;
+  attempts = 0;
+  start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    attempts += bitboard_fleet(&bitboards[r], &seed);
+  }
+  double bitboard_place = (now_ns() - start) / attempts;
+  double retry_fleet = (now_ns() - start) / ROUNDS;
+
+  // Флот целиком: fleet_random выбирает только из допустимых позиций
+  uint8_t random_fleet[MAX_SHIPS];
+  start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    fleet_random(random_fleet, &seed);
+    checksum += random_fleet[0];
+  }
+  double sampled_fleet = (now_ns() - start) / ROUNDS;
+
+  // Выстрелы: все 100 клеток в случайном порядке, конец игры после каждого
+  int cells[BOARD_SIZE * BOARD_SIZE];
+  for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; i++) {
+    cells[i] = i;
+  }
+  double legacy_shot = 0, bitboard_shot = 0;
+  seed = 777;
+  for (int r = 0; r < ROUNDS; r++) {
+    shuffle(cells, &seed);
+    memset(shots, 0, sizeof(shots));
+
+    start = now_ns();
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; i++) {
+      checksum += legacy_make_shot(boards[r], shots, cells[i] % BOARD_SIZE,
+                                   cells[i] / BOARD_SIZE);
+    }
+    legacy_shot += now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; i++) {
+      checksum += board_shot(&bitboards[r], cells[i] % BOARD_SIZE,
+                             cells[i] / BOARD_SIZE);
+    }
+    bitboard_shot += now_ns() - start;
+  }
+  legacy_shot /= (double)ROUNDS * BOARD_SIZE * BOARD_SIZE;
+  bitboard_shot /= (double)ROUNDS * BOARD_SIZE * BOARD_SIZE;
+
+  // Конец игры: доски с одной непотопленной клеткой (худший случай для
+  // полного обхода) и свежие доски
+  static int legacy_snap[SNAPSHOTS][BOARD_SIZE][BOARD_SIZE];
+  static Board bitboard_snap[SNAPSHOTS];
+  seed = 4242;
+  for (int i = 0; i < SNAPSHOTS; i++) {
+    legacy_fleet(legacy_snap[i], &seed);
+    bitboard_fleet(&bitboard_snap[i], &seed);
+    if (i % 2 == 0) {
+      // Не подбита только последняя клетка кораблей
+      int last = BOARD_SIZE * BOARD_SIZE - 1;
+      while (legacy_snap[i][last / BOARD_SIZE][last % BOARD_SIZE] != 1) {
+        last--;
+      }
+      for (int c = 0; c < last; c++) {
+        int *cell = &legacy_snap[i][c / BOARD_SIZE][c % BOARD_SIZE];
+        if (*cell == 1) {
+          *cell = 3;
+        }
+      }
+
+      Board *b = &bitboard_snap[i];
+      b->hits = b->ships;
+      for (last = BOARD_SIZE * BOARD_SIZE - 1;; last--) {
+        uint64_t *word = last < 64 ? &b->hits.lo : &b->hits.hi;
+        uint64_t bit = 1ull << (last % 64);
+        if (*word & bit) {
+          *word &= ~bit;
+          break;
+        }
+      }
+    }
+  }
+
+  int checks = ROUNDS * 100;
+  start = now_ns();
+  for (int i = 0; i < checks; i++) {
+    checksum += legacy_check_game_over(legacy_snap[i % SNAPSHOTS]);
+  }
+  double legacy_over = (now_ns() - start) / checks;
+
+  start = now_ns();
+  for (int i = 0; i < checks; i++) {
+    checksum += board_all_sunk(&bitboard_snap[i % SNAPSHOTS]);
+  }
+  double bitboard_over = (now_ns() - start) / checks;
+
+  printf("%-12s %12s %12s\n", "operation", "int ns/op", "bitboard ns/op");
+  printf("%-12s %12.1f %12.1f\n", "placement", legacy_place, bitboard_place);
+  printf("%-12s %12.1f %12.1f\n", "shot", legacy_shot, bitboard_shot);
+  printf("%-12s %12.1f %12.1f\n", "game over", legacy_over, bitboard_over);
+  printf("\nfleet: retries %.1f ns, fleet_random %.1f ns (%.2f M fleets/s)\n",
+         retry_fleet, sampled_fleet, 1e3 / sampled_fleet);
+  printf("\nsizeof: int board + shots %zu bytes, Board %zu bytes\n",
+         2 * sizeof(int) * BOARD_SIZE * BOARD_SIZE, sizeof(Board));
+
+  if (checksum == 42) {
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,144 @@
+// Бенчмарк поиска в реестре сервера: стоимость одного сообщения
+// (find_player -> find_game_by_id -> индекс игрока -> соперник)
+// при росте числа зарегистрированных игроков. Запрос с дескриптором
+// сессии ищет игрока по id, запрос старого клиента - по логину.
+//
+// Игрок запроса выбирается случайно из всех зарегистрированных. Число
+// обращений к памяти на сообщение не зависит от размера реестра, но
+// с сотен тысяч игроков записи перестают помещаться в кэш и почти
+// каждое обращение - промах: на 1M игроков сообщение по дескриптору
+// стоит в 5-10 раз дороже, чем на 100.
+#include "registry.h"
+#include <time.h>
+
+#define LOOKUPS 2000000
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Старый вариант: линейный проход по массиву записей
+static Player **all_players;
+static size_t all_player_count;
+static Game **all_games;
+static size_t all_game_count;
+
+static Player *linear_find_player(const char *login) {
+  for (size_t i = 0; i < all_player_count; i++) {
+    if (strcmp(all_players[i]->login, login) == 0) {
+      return all_players[i];
+    }
+  }
+  return NULL;
+}
+
+static Game *linear_find_game_by_id(int64_t id) {
+  for (size_t i = 0; i < all_game_count; i++) {
+    if (all_games[i]->id == id) {
+      return all_games[i];
+    }
+  }
+  return NULL;
+}
+
+static uint32_t next_rand(uint32_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void run(size_t player_total) {
+  size_t game_total = player_total / 2;
+
+  Registry reg;
+  if (!registry_init(&reg, player_total, game_total)) {
+    fprintf(stderr, "Out of memory for %zu players\n", player_total);
+    return;
+  }
+
+  char(*logins)[MAX_PLAYER_NAME] = malloc(player_total * MAX_PLAYER_NAME);
+  all_players = malloc(player_total * sizeof(Player *));
+  all_games = malloc(game_total * sizeof(Game *));
+  all_player_count = player_total;
+  all_game_count = game_total;
+  for (size_t i = 0; i < player_total; i++) {
+    snprintf(logins[i], MAX_PLAYER_NAME, "player_%zu", i);
+    all_players[i] = registry_add_player(&reg, logins[i], "");
+  }
+
+  // Все игроки сидят в играх парами: поиск идёт по всему реестру
+  for (size_t g = 0; g < game_total; g++) {
+    char name[MAX_GAME_NAME];
+    snprintf(name, sizeof(name), "game_%zu", g);
+    Game *game =
+        registry_create_game(&reg, name, registry_find_player(&reg, logins[2 * g]));
+    registry_join_game(&reg, game, registry_find_player(&reg, logins[2 * g + 1]));
+    all_games[g] = game;
+  }
+
+  uint32_t seed = 12345;
+  long checksum = 0;
+
+  double start = now_ns();
+  for (int i = 0; i < LOOKUPS; i++) {
+    int64_t session = all_players[next_rand(&seed) % player_total]->id;
+    Player *p = registry_find_player_by_id(&reg, session);
+    Game *game = registry_find_game_by_id(&reg, p->game_id);
+    int idx = game_player_index(game, p);
+    checksum += game->player_refs[1 - idx]->game_id;
+  }
+  double by_session = (now_ns() - start) / LOOKUPS;
+
+  start = now_ns();
+  for (int i = 0; i < LOOKUPS; i++) {
+    const char *login = logins[next_rand(&seed) % player_total];
+    Player *p = registry_find_player(&reg, login);
+    Game *game = registry_find_game_by_id(&reg, p->game_id);
+    int idx = game_player_index(game, p);
+    checksum += game->player_refs[1 - idx]->game_id;
+  }
+  double hashed = (now_ns() - start) / LOOKUPS;
+
+  // Линейный поиск меряем только на небольших размерах
+  double linear = -1;
+  if (player_total <= 10000) {
+    int rounds = LOOKUPS / 100;
+    start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+      const char *login = logins[next_rand(&seed) % player_total];
+      Player *p = linear_find_player(login);
+      Game *game = linear_find_game_by_id(p->game_id);
+      checksum += game->id;
+    }
+    linear = (now_ns() - start) / rounds;
+  }
+
+  printf("%10zu %10zu %14.1f %12.1f", player_total, game_total, by_session,
+         hashed);
+  if (linear < 0) {
+    printf(" %12s\n", "-");
+  } else {
+    printf(" %12.1f\n", linear);
+  }
+
+  if (checksum == 42) {
+    printf("\n");
+  }
+
+  free(logins);
+  free(all_players);
+  free(all_games);
+  registry_free(&reg);
+}
+
+int main(void) {
+  printf("%10s %10s %14s %12s %12s\n", "players", "games", "session ns/msg",
+         "hash ns/msg", "linear ns/msg");
+  for (size_t n = 100; n <= 1000000; n *= 10) {
+    run(n);
+  }
+  return 0;
+}
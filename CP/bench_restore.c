@@ -0,0 +1,151 @@
+// Бенчмарк перезапуска сервера: загрузка снимка с живыми партиями и
+// раскладка игроков и партий по лобби и воркерам (journal_restore).
+// Журнал с партиями пишет дочерний процесс, второй превращает его в
+// снимок, замеряется третий запуск - как после обычного перезапуска.
+#include "journal.h"
+#include <dirent.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define WORKERS 4
+#define SHOTS_PER_GAME 20
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int64_t bench_id(size_t slot) {
+  return (int64_t)((uint64_t)1 << POOL_SLOT_BITS | slot);
+}
+
+// Партии в расстановке и в игре, у каждой - два игрока
+static void write_journal(const char *dir, size_t game_total) {
+  static Registry state;
+  if (!registry_init(&state, MAX_SERVER_PLAYERS, MAX_GAMES) ||
+      !journal_open(dir, &state) || !journal_start()) {
+    exit(1);
+  }
+  uint32_t rng = 12345;
+  for (size_t g = 0; g < game_total; g++) {
+    char logins[MAX_PLAYERS][MAX_PLAYER_NAME];
+    char name[MAX_GAME_NAME];
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+      snprintf(logins[i], MAX_PLAYER_NAME, "player_%zu", 2 * g + i);
+      journal_register(bench_id(2 * g + i), logins[i]);
+    }
+    snprintf(name, sizeof(name), "game_%zu", g);
+    journal_create(bench_id(g), logins[0], name);
+    journal_join(bench_id(g), logins[1]);
+    if (g % 4 == 0) {
+      continue; // ещё расставляют корабли
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+      uint8_t fleet[MAX_SHIPS];
+      fleet_random(fleet, &rng);
+      journal_place_fleet(bench_id(g), i, fleet);
+    }
+    for (int s = 0; s < SHOTS_PER_GAME; s++) {
+      int cell = (int)(random_next(&rng) % (BOARD_SIZE * BOARD_SIZE));
+      journal_shot(bench_id(g), s % 2, cell % BOARD_SIZE, cell / BOARD_SIZE);
+    }
+  }
+  journal_stop();
+}
+
+static void remove_dir(const char *dir) {
+  DIR *d = opendir(dir);
+  if (d == NULL) {
+    return;
+  }
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    if (e->d_name[0] != '.') {
+      char path[512];
+      snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+      unlink(path);
+    }
+  }
+  closedir(d);
+  rmdir(dir);
+}
+
+// Замер - как в restore_state сервера
+static void measure(const char *dir, size_t game_total) {
+  static Registry state, threads[WORKERS + 1];
+  Registry *workers[WORKERS];
+  bool ok = registry_init(&state, MAX_SERVER_PLAYERS, MAX_GAMES);
+  for (int i = 0; i <= WORKERS; i++) {
+    ok = ok && registry_init(&threads[i], MAX_SERVER_PLAYERS, MAX_GAMES);
+  }
+  for (int i = 0; i < WORKERS; i++) {
+    workers[i] = &threads[i + 1];
+  }
+
+  double start = now_ns();
+  ok = ok && journal_open(dir, &state);
+  double load = now_ns() - start;
+  start = now_ns();
+  ok = ok && journal_restore(&state, &threads[0], workers, WORKERS);
+  double hand_out = now_ns() - start;
+  if (!ok) {
+    fprintf(stderr, "Restore of %zu games failed\n", game_total);
+    exit(1);
+  }
+  printf("%10zu %10zu %12.1f %12.1f\n", game_total, threads[0].players.count,
+         load / 1e6, hand_out / 1e6);
+}
+
+typedef enum { STEP_JOURNAL, STEP_SNAPSHOT, STEP_MEASURE } Step;
+
+// Каждый шаг - в своём процессе: состояние журнала глобальное, и каждый
+// запуск начинается с чистого, как у сервера
+static void run_step(const char *dir, size_t game_total, Step step) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    static Registry state;
+    switch (step) {
+    case STEP_JOURNAL:
+      freopen("/dev/null", "w", stdout);
+      write_journal(dir, game_total);
+      break;
+    case STEP_SNAPSHOT:
+      freopen("/dev/null", "w", stdout);
+      if (!registry_init(&state, MAX_SERVER_PLAYERS, MAX_GAMES) ||
+          !journal_open(dir, &state)) {
+        exit(1);
+      }
+      break;
+    case STEP_MEASURE:
+      measure(dir, game_total);
+      break;
+    }
+    fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Benchmark of %zu games failed in %s\n", game_total, dir);
+    exit(1);
+  }
+}
+
+int main(void) {
+  printf("%10s %10s %12s %12s\n", "games", "players", "load ms",
+         "hand-out ms");
+  for (size_t n = 1000; n <= 100000; n *= 10) {
+    char dir[] = "/tmp/bench_restore-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+      perror("mkdtemp");
+      return 1;
+    }
+    run_step(dir, n, STEP_JOURNAL);
+    run_step(dir, n, STEP_SNAPSHOT);
+    run_step(dir, n, STEP_MEASURE);
+    remove_dir(dir);
+  }
+  return 0;
+}
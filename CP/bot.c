@@ -0,0 +1,163 @@
+#include "bot.h"
+#include <pthread.h>
+
+#define CELL_COUNT (BOARD_SIZE * BOARD_SIZE)
+#define MAX_SHIP_SIZE 4
+// Позиций корабля длины 2 и больше - по BOARD_SIZE * (BOARD_SIZE - s + 1)
+// в каждой ориентации
+#define MAX_POSITIONS (2 * BOARD_SIZE * BOARD_SIZE)
+
+// Битовая доска как вектор из двух 64-битных половин: операции над
+// ним компилятор переводит в SSE2/NEON. Счётчики карты плотности
+// хранятся по битам (bit-slicing): плоскость k - k-е биты счётчиков
+// всех клеток, так что одно сложение обновляет сразу 100 клеток.
+typedef uint64_t Lanes __attribute__((vector_size(16)));
+
+// Позиций одного корабля через клетку не больше 2 * MAX_SHIP_SIZE,
+// сумма весов всех кораблей - меньше 64
+#define COUNT_BITS 4
+#define HEAT_BITS 6
+
+typedef struct {
+  Lanes ship;
+  Lanes halo; // клетки корабля и соседние
+} Position;
+
+static Position positions[MAX_SHIP_SIZE + 1][MAX_POSITIONS];
+static int position_count[MAX_SHIP_SIZE + 1];
+static Lanes all_cells;
+static pthread_once_t positions_once = PTHREAD_ONCE_INIT;
+
+static inline Lanes lanes_cell(int cell) {
+  return cell < 64 ? (Lanes){1ull << cell, 0}
+                   : (Lanes){0, 1ull << (cell - 64)};
+}
+
+static inline Lanes lanes_of(Bitboard b) { return (Lanes){b.lo, b.hi}; }
+
+static inline bool lanes_empty(Lanes v) { return (v[0] | v[1]) == 0; }
+
+static void init_positions(void) {
+  for (int cell = 0; cell < CELL_COUNT; cell++) {
+    all_cells |= lanes_cell(cell);
+  }
+  for (int size = 1; size <= MAX_SHIP_SIZE; size++) {
+    // У однопалубного обе ориентации совпадают
+    for (int h = 0; h < (size > 1 ? 2 : 1); h++) {
+      for (int y = 0; y + (h ? 1 : size) <= BOARD_SIZE; y++) {
+        for (int x = 0; x + (h ? size : 1) <= BOARD_SIZE; x++) {
+          Position *p = &positions[size][position_count[size]++];
+          for (int i = 0; i < size; i++) {
+            int cx = h ? x + i : x, cy = h ? y : y + i;
+            p->ship |= lanes_cell(cy * BOARD_SIZE + cx);
+            for (int dy = -1; dy <= 1; dy++) {
+              for (int dx = -1; dx <= 1; dx++) {
+                if (cx + dx >= 0 && cx + dx < BOARD_SIZE && cy + dy >= 0 &&
+                    cy + dy < BOARD_SIZE) {
+                  p->halo |= lanes_cell((cy + dy) * BOARD_SIZE + cx + dx);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// count += mask: полусумматоры по плоскостям, перенос гаснет быстро
+static inline void count_add(Lanes count[COUNT_BITS], Lanes mask) {
+  for (int k = 0; k < COUNT_BITS && !lanes_empty(mask); k++) {
+    Lanes carry = count[k] & mask;
+    count[k] ^= mask;
+    mask = carry;
+  }
+}
+
+// heat += count << shift: полные сумматоры по плоскостям
+static void heat_add(Lanes heat[HEAT_BITS], const Lanes count[COUNT_BITS],
+                     int shift) {
+  Lanes carry = {0, 0};
+  for (int k = shift; k < HEAT_BITS; k++) {
+    Lanes b = k - shift < COUNT_BITS ? count[k - shift] : (Lanes){0, 0};
+    Lanes a = heat[k];
+    heat[k] = a ^ b ^ carry;
+    carry = (a & b) | (carry & (a ^ b));
+  }
+}
+
+// k-я (с нуля) установленная клетка
+static int nth_cell(Lanes set, int k) {
+  for (int half = 0; half < 2; half++) {
+    uint64_t bits = set[half];
+    int n = bit_count(bits);
+    if (k < n) {
+      while (k-- > 0) {
+        bits &= bits - 1;
+      }
+      return half * 64 + __builtin_ctzll(bits);
+    }
+    k -= n;
+  }
+  return -1;
+}
+
+int bot_choose_shot(const Board *target, uint32_t *rng) {
+  pthread_once(&positions_once, init_positions);
+
+  Lanes hits = lanes_of(target->hits);
+  Lanes misses = lanes_of(target->misses);
+  Lanes sunk = {0, 0};
+  int afloat[MAX_SHIP_SIZE + 1] = {0};
+  for (int i = 0; i < target->ship_count; i++) {
+    Lanes ship = lanes_of(target->ship_cells[i]);
+    if (target->hits_left[i] == 0) {
+      sunk |= ship;
+    } else {
+      afloat[bit_count(ship[0]) + bit_count(ship[1])]++;
+    }
+  }
+  // Попадания по кораблям на плаву; пока они есть - добиваем
+  Lanes open = hits & ~sunk;
+  bool targeting = !lanes_empty(open);
+  Lanes blocked = misses | sunk;
+
+  Lanes heat[HEAT_BITS] = {{0}};
+  for (int size = 1; size <= MAX_SHIP_SIZE; size++) {
+    if (afloat[size] == 0) {
+      continue;
+    }
+    Lanes count[COUNT_BITS] = {{0}};
+    const Position *p = positions[size];
+    for (int i = 0; i < position_count[size]; i++) {
+      // Корабль не лежит на промахах и потопленных, не касается
+      // потопленных и попаданий, которых не накрывает сам
+      Lanes bad = (p[i].ship & blocked) | (p[i].halo & sunk) |
+                  (p[i].halo & ~p[i].ship & open);
+      if (lanes_empty(bad) &&
+          (!targeting || !lanes_empty(p[i].ship & open))) {
+        count_add(count, p[i].ship);
+      }
+    }
+    // Вес позиции - число кораблей этой длины на плаву (не больше 4)
+    for (int bit = 0; bit < 3; bit++) {
+      if (afloat[size] & (1 << bit)) {
+        heat_add(heat, count, bit);
+      }
+    }
+  }
+
+  // Максимум по плоскостям от старшей: оставляем клетки, где бит есть
+  Lanes best = all_cells & ~(hits | misses);
+  if (lanes_empty(best)) {
+    return -1;
+  }
+  for (int k = HEAT_BITS - 1; k >= 0; k--) {
+    Lanes top = best & heat[k];
+    if (!lanes_empty(top)) {
+      best = top;
+    }
+  }
+  int n = bit_count(best[0]) + bit_count(best[1]);
+  return nth_cell(best, (int)(random_next(rng) % (uint32_t)n));
+}
@@ -0,0 +1,27 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "common.h"
+
+// Встроенный соперник сервера (MSG_PLAY_BOT).
+//
+// Бот - виртуальный игрок воркера: флот (fleet_random) расставляется
+// при создании партии, ходы делаются сразу после хода человека в том же
+// потоке. Выстрел выбирается по карте плотности: для каждого корабля,
+// который ещё на плаву, перебираются все его позиции, не противоречащие
+// полю (не задевают промахи, потопленные корабли и их ореол, не касаются
+// чужих попаданий сбоку), и каждая добавляет свой вес клеткам, которые
+// занимает. Пока есть подбитый, но не потопленный корабль, считаются
+// только позиции через его попадания (добивание). Бот стреляет в
+// непростреленную клетку с наибольшей плотностью, из равных - в
+// случайную.
+//
+// Используется только открытая часть поля соперника: попадания,
+// промахи и потопленные корабли (о них игроку сообщает SHOT_SUNK).
+#define BOT_LOGIN_PREFIX "bot-"
+
+// Клетка y * BOARD_SIZE + x следующего выстрела по полю target;
+// -1, если стрелять некуда. rng - состояние random_next.
+int bot_choose_shot(const Board *target, uint32_t *rng);
+
+#endif // BOT_H
@@ -0,0 +1,270 @@
+#include "common.h"
+#include "log.h"
+#include "protocol.h"
+#include "reactor.h"
+#include "spectator.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Брокер перед процессами сервера.
+//
+// Клиенты подключаются к брокеру так же, как к одиночному серверу.
+// Запросы лобби (регистрация, создание и поиск игр, приглашения) идут
+// процессу-каталогу (server -r directory): он один знает всех игроков,
+// поэтому приглашения и вход в чужую игру работают, где бы ни шла
+// партия. Запросы по партии идут шарду игр (server -r games), которому
+// принадлежит game_id. Внутренние сообщения (пустой identity) брокер
+// передаёт между каталогом и шардами: от каталога - шарду партии, от
+// шарда - каталогу. Трансляции шардов брокер собирает в один XPUB на
+// своём порту + SPECTATOR_PORT_OFFSET.
+//
+// Брокер не ждёт места в очередях: запрос к шарду с полной очередью
+// отбрасывается, клиент сразу получает ST_SERVER_BUSY. Иначе один
+// отставший шард остановил бы весь брокер, а с ним и ответы остальных.
+#define MAX_SHARDS 64
+#define BROKER_QUEUE 65536 // кадров в очереди каждого сокета, в каждую сторону
+
+typedef struct {
+  void *clients;            // ROUTER
+  void *shards[MAX_SHARDS]; // DEALER; [0] - каталог, дальше шарды игр
+  int shard_count;
+  void *watchers; // XPUB для зрителей
+  void *feeds;    // XSUB к трансляциям шардов игр
+  zmq_msg_t identity;
+  zmq_msg_t payload;
+  uint64_t dropped[MAX_SHARDS]; // запросы, не принятые шардом подряд
+  uint8_t busy[32];             // готовый ответ MSG_ERROR / ST_SERVER_BUSY
+  size_t busy_size;
+} Broker;
+
+// Шард игр партии. Биты id перемешиваются: иначе при равном числе шардов
+// и воркеров в шарде (game_id % N) на шарде работал бы один воркер.
+static int game_shard(const Broker *b, int64_t game_id) {
+  uint32_t h = (uint32_t)(((uint64_t)game_id * 0x9E3779B97F4A7C15u) >> 32);
+  return 1 + (int)(((uint64_t)h * (uint64_t)(b->shard_count - 1)) >> 32);
+}
+
+// false - очередь сокета полна, кадры остались в сообщениях
+static bool forward(void *socket, zmq_msg_t *identity, zmq_msg_t *payload) {
+  if (zmq_msg_send(identity, socket, ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0)
+    return false;
+  zmq_msg_send(payload, socket, ZMQ_DONTWAIT);
+  return true;
+}
+
+// Текущее сообщение шарду. Начало и конец серии отброшенных запросов
+// попадают в журнал один раз, а не на каждый запрос.
+static bool send_to_shard(Broker *b, int shard) {
+  if (forward(b->shards[shard], &b->identity, &b->payload)) {
+    if (b->dropped[shard] > 0) {
+      log_info("Shard %d accepts requests again, %d dropped", shard,
+               b->dropped[shard]);
+      b->dropped[shard] = 0;
+    }
+    return true;
+  }
+  if (b->dropped[shard]++ == 0) {
+    log_warn("Shard %d queue is full, dropping requests", shard);
+  }
+  return false;
+}
+
+static void set_queue(void *socket) {
+  int hwm = BROKER_QUEUE;
+  zmq_setsockopt(socket, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+  zmq_setsockopt(socket, ZMQ_RCVHWM, &hwm, sizeof(hwm));
+}
+
+// Принимает [identity][payload], лишние кадры отбрасывает
+static bool broker_recv(Broker *b, void *socket) {
+  if (zmq_msg_recv(&b->identity, socket, ZMQ_DONTWAIT) < 0)
+    return false;
+  zmq_msg_recv(&b->payload, socket, 0);
+  // DEALER присылает кадр без пустого разделителя, REQ - с ним
+  if (zmq_msg_size(&b->payload) == 0 && zmq_msg_more(&b->payload)) {
+    zmq_msg_recv(&b->payload, socket, 0);
+  }
+  zmq_msg_t rest;
+  zmq_msg_init(&rest);
+  bool more = zmq_msg_more(&b->payload);
+  while (more && zmq_msg_recv(&rest, socket, 0) >= 0) {
+    more = zmq_msg_more(&rest);
+  }
+  zmq_msg_close(&rest);
+  return true;
+}
+
+static bool peek(Broker *b, MessageType *type, int64_t *game_id) {
+  size_t size = zmq_msg_size(&b->payload);
+  return size > 0 && size <= PROTO_MAX_FRAME &&
+         proto_peek(zmq_msg_data(&b->payload), size, type, game_id);
+}
+
+static bool from_client(void *ctx, void *socket) {
+  Broker *b = ctx;
+  if (!broker_recv(b, socket))
+    return false;
+
+  MessageType type;
+  int64_t game_id;
+  if (!proto_client_identity(zmq_msg_data(&b->identity),
+                             zmq_msg_size(&b->identity)) ||
+      !peek(b, &type, &game_id))
+    return true;
+
+  int shard = proto_is_game_request(type) ? game_shard(b, game_id) : 0;
+  if (!send_to_shard(b, shard) &&
+      zmq_msg_send(&b->identity, b->clients, ZMQ_SNDMORE | ZMQ_DONTWAIT) >=
+          0) {
+    zmq_send(b->clients, b->busy, b->busy_size, ZMQ_DONTWAIT);
+  }
+  return true;
+}
+
+static bool from_shard(void *ctx, void *socket) {
+  Broker *b = ctx;
+  if (!broker_recv(b, socket))
+    return false;
+
+  if (zmq_msg_size(&b->identity) > 0) {
+    forward(b->clients, &b->identity, &b->payload);
+    return true;
+  }
+
+  MessageType type;
+  int64_t game_id;
+  if (peek(b, &type, &game_id)) {
+    int shard = socket == b->shards[0] ? game_shard(b, game_id) : 0;
+    send_to_shard(b, shard);
+  }
+  return true;
+}
+
+// Подписки зрителей уходят всем шардам игр: снимок пришлёт тот, у кого
+// партия
+static bool from_watchers(void *ctx, void *socket) {
+  Broker *b = ctx;
+  if (zmq_msg_recv(&b->payload, socket, ZMQ_DONTWAIT) < 0)
+    return false;
+  zmq_msg_send(&b->payload, b->feeds, 0);
+  return true;
+}
+
+static bool from_feeds(void *ctx, void *socket) {
+  Broker *b = ctx;
+  if (zmq_msg_recv(&b->payload, socket, ZMQ_DONTWAIT) < 0)
+    return false;
+  int more = zmq_msg_more(&b->payload);
+  zmq_msg_send(&b->payload, b->watchers, more ? ZMQ_SNDMORE : 0);
+  while (more && zmq_msg_recv(&b->payload, socket, 0) >= 0) {
+    more = zmq_msg_more(&b->payload);
+    zmq_msg_send(&b->payload, b->watchers, more ? ZMQ_SNDMORE : 0);
+  }
+  return true;
+}
+
+// tcp://host:port -> tcp://host:(port + offset)
+static bool shift_port(const char *endpoint, int offset, char *out,
+                       size_t size) {
+  const char *colon = strrchr(endpoint, ':');
+  if (colon == NULL || atoi(colon + 1) <= 0) {
+    return false;
+  }
+  snprintf(out, size, "%.*s:%d", (int)(colon - endpoint), endpoint,
+           atoi(colon + 1) + offset);
+  return true;
+}
+
+static bool bind_socket(void *socket, int port) {
+  char address[64];
+  snprintf(address, sizeof(address), "tcp://*:%d", port);
+  if (zmq_bind(socket, address) != 0) {
+    fprintf(stderr, "Error binding %s: %s\n", address, zmq_strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  int port = atoi(SERVER_PORT);
+  int opt;
+  while ((opt = getopt(argc, argv, "p:")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    default:
+      optind = argc + 1;
+      break;
+    }
+  }
+  int shard_count = argc - optind;
+  if (shard_count < 2 || shard_count > MAX_SHARDS || port <= 0) {
+    fprintf(stderr,
+            "Usage: %s [-p port] directory_endpoint game_endpoint...\n"
+            "  e.g. %s tcp://localhost:6000 tcp://localhost:6010\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  if (!log_start()) {
+    fprintf(stderr, "Error starting log thread\n");
+    return 1;
+  }
+
+  void *context = zmq_ctx_new();
+  static Broker b;
+  b.shard_count = shard_count;
+  b.clients = zmq_socket(context, ZMQ_ROUTER);
+  b.watchers = zmq_socket(context, ZMQ_XPUB);
+  b.feeds = zmq_socket(context, ZMQ_XSUB);
+  set_queue(b.clients);
+  int verbose = 1;
+  zmq_setsockopt(b.watchers, ZMQ_XPUB_VERBOSE, &verbose, sizeof(verbose));
+  Message busy = {0};
+  busy.type = MSG_ERROR;
+  busy.status = ST_SERVER_BUSY;
+  b.busy_size = proto_encode(&busy, b.busy, sizeof(b.busy));
+  if (!bind_socket(b.clients, port) ||
+      !bind_socket(b.watchers, port + SPECTATOR_PORT_OFFSET)) {
+    return 1;
+  }
+
+  for (int i = 0; i < shard_count; i++) {
+    const char *endpoint = argv[optind + i];
+    b.shards[i] = zmq_socket(context, ZMQ_DEALER);
+    set_queue(b.shards[i]);
+    if (zmq_connect(b.shards[i], endpoint) != 0) {
+      fprintf(stderr, "Error connecting to %s: %s\n", endpoint,
+              zmq_strerror(errno));
+      return 1;
+    }
+    char feed[256];
+    if (i > 0 && (!shift_port(endpoint, SPECTATOR_PORT_OFFSET, feed,
+                              sizeof(feed)) ||
+                  zmq_connect(b.feeds, feed) != 0)) {
+      fprintf(stderr, "Error connecting spectators of %s\n", endpoint);
+      return 1;
+    }
+  }
+
+  zmq_msg_init(&b.identity);
+  zmq_msg_init(&b.payload);
+  static Reactor reactor;
+  reactor_init(&reactor, REACTOR_BATCH);
+  reactor_add_socket(&reactor, b.clients, from_client, &b);
+  for (int i = 0; i < shard_count; i++) {
+    reactor_add_socket(&reactor, b.shards[i], from_shard, &b);
+  }
+  reactor_add_socket(&reactor, b.watchers, from_watchers, &b);
+  reactor_add_socket(&reactor, b.feeds, from_feeds, &b);
+
+  printf("Sea Battle broker on port %d: directory %s, %d game shards\n",
+         port, argv[optind], shard_count - 1);
+  printf("Spectators on tcp://*:%d\n", port + SPECTATOR_PORT_OFFSET);
+
+  reactor_run(&reactor);
+  return 0;
+}
@@ -1,4 +1,7 @@
 #include "common.h"
+#include "protocol.h"
+#include "render.h"
+#include "spectator.h"
 #include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
@@ -6,62 +9,134 @@
 #include <time.h>
 
 static char player_login[MAX_PLAYER_NAME] = "";
-static int current_game_id = -1;
+static uint64_t session; // выдаётся при регистрации, им подписаны запросы
+static int64_t current_game_id = -1;
 static int my_board[BOARD_SIZE][BOARD_SIZE];
 static int opponent_shots[BOARD_SIZE][BOARD_SIZE];
 static bool in_game = false;
 static bool game_started = false;
 static bool my_turn = false;
+static uint32_t placement_rng; // состояние fleet_random
+
+// Чего клиент ждёт от следующей строки stdin. Ввод и сообщения сервера
+// разбираются в одном цикле zmq_poll, поэтому каждый вопрос
+// пользователю - состояние, а не блокирующий scanf.
+typedef enum {
+  INPUT_MENU,
+  INPUT_GAME_NAME,  // имя новой партии
+  INPUT_TURN_LIMIT, // затем срок хода
+  INPUT_JOIN_NAME,
+  INPUT_INVITE_LOGIN,
+  INPUT_INVITATION, // ответ на приглашение в партию pending_name
+  INPUT_PLACEMENT_MODE,
+  INPUT_SHIP, // ручная расстановка, корабль ships_placed
+  INPUT_SHOT,
+  INPUT_WAIT, // ввода не ждём: очередь быстрой игры, ход соперника
+} InputState;
+
+static InputState input_state = INPUT_MENU;
+static bool prompt_needed = true; // вопрос нового состояния ещё не задан
+static char pending_name[MAX_GAME_NAME];
+static uint8_t pending_fleet[MAX_SHIPS];
+static int ships_placed;
+static bool auto_placement;
+
+// Строки stdin копятся здесь, пока не придёт перевод строки
+#define INPUT_LINE_SIZE 256
+static char input_line[INPUT_LINE_SIZE];
+static size_t input_len;
+
+// Вопрос задаётся один раз, когда цикл обработает все готовые события
+static void set_state(InputState state) {
+  input_state = state;
+  prompt_needed = true;
+}
 
-bool ask_yes_no(const char *question, bool default_value) {
-  char buf[32];
-
-  int c;
-  while ((c = getchar()) != '\n' && c != EOF)
-    ;
-
-  while (1) {
-    printf("%s [%c/%c]: ", question, default_value ? 'Y' : 'y',
-           default_value ? 'n' : 'N');
-
-    if (!fgets(buf, sizeof(buf), stdin)) {
-      // EOF → используем дефолт
-      return default_value;
-    }
-
-    // Убираем \n
-    buf[strcspn(buf, "\n")] = '\0';
-
-    // Пустой ввод → дефолт
-    if (buf[0] == '\0') {
-      return default_value;
-    }
-
-    // Берём первый значащий символ
-    char c = tolower((unsigned char)buf[0]);
-
-    if (c == 'y')
-      return true;
-    if (c == 'n')
-      return false;
+// Ответ y/n: 1 - да, 0 - нет, пустая строка - default_value, -1 - не
+// разобрали
+static int parse_yes_no(const char *line, bool default_value) {
+  line += strspn(line, " \t");
+  if (*line == '\0') {
+    return default_value;
+  }
+  char c = tolower((unsigned char)*line);
+  if (c == 'y')
+    return 1;
+  if (c == 'n')
+    return 0;
+  printf("Please enter 'y' or 'n'.\n");
+  return -1;
+}
 
-    printf("Please enter 'y' or 'n'.\n");
+// Первое слово строки; false - строка пустая
+static bool first_word(const char *line, char *word, size_t size) {
+  line += strspn(line, " \t");
+  size_t len = strcspn(line, " \t");
+  if (len == 0) {
+    return false;
   }
+  if (len >= size) {
+    len = size - 1;
+  }
+  memcpy(word, line, len);
+  word[len] = '\0';
+  return true;
 }
 
-int send_message(void *socket, Message *msg) {
-  int size = zmq_send(socket, msg, sizeof(Message), 0);
-  return size == sizeof(Message);
+static void start_placement(void) {
+  printf("\n=== Placing Ships ===\n");
+  init_board(my_board);
+  init_board(opponent_shots);
+  set_state(INPUT_PLACEMENT_MODE);
 }
 
-int receive_message(void *socket, Message *msg) {
-  int size = zmq_recv(socket, msg, sizeof(Message), 0);
-  return size == sizeof(Message);
+static const char *shot_result_text(ShotResult result) {
+  switch (result) {
+  case SHOT_MISS:
+    return "Miss!";
+  case SHOT_HIT:
+    return "Hit!";
+  case SHOT_SUNK:
+    return "Ship sunk!";
+  default:
+    return "Invalid shot";
+  }
 }
 
-int receive_message_nonblock(void *socket, Message *msg) {
-  int size = zmq_recv(socket, msg, sizeof(Message), ZMQ_DONTWAIT);
-  return size == sizeof(Message);
+static void handle_server_response(const Message *msg);
+
+#define REPLY_TIMEOUT_MS 5000
+
+// Ожидание ответа на запрос; уведомления, пришедшие раньше, обрабатываются.
+// Ждём не дольше REPLY_TIMEOUT_MS: опоздавший ответ потом разберёт главный
+// цикл, а пользователь не остаётся перед зависшим клиентом.
+static bool receive_reply(void *socket, Message *response) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (;;) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - start.tv_sec) * 1000 +
+                   (now.tv_nsec - start.tv_nsec) / 1000000;
+    zmq_pollitem_t item = {socket, 0, ZMQ_POLLIN, 0};
+    int rc = elapsed < REPLY_TIMEOUT_MS
+                 ? zmq_poll(&item, 1, REPLY_TIMEOUT_MS - elapsed)
+                 : 0;
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      printf("No reply from server\n");
+      return false;
+    }
+    if (!receive_message(socket, response)) {
+      return false;
+    }
+    if (!proto_is_push(response)) {
+      return true;
+    }
+    handle_server_response(response);
+  }
 }
 
 bool register_player(void *socket, const char *login) {
@@ -73,38 +148,41 @@ bool register_player(void *socket, const char *login) {
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
+  if (receive_reply(socket, &response)) {
     if (response.type == MSG_ACK) {
       printf("Successfully registered as %s\n", login);
       strncpy(player_login, login, MAX_PLAYER_NAME - 1);
+      session = response.session;
       return true;
     } else {
-      printf("Registration failed: %s\n", response.data);
+      printf("Registration failed: %s\n", status_text(response.status));
       return false;
     }
   }
   return false;
 }
 
-bool create_game(void *socket, const char *game_name) {
+// turn_limit - секунд на ход, 0 - по умолчанию сервера
+bool create_game(void *socket, const char *game_name, int turn_limit) {
   Message msg = {0};
   msg.type = MSG_CREATE_GAME;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.session = session;
+  msg.x = turn_limit;
   strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
   strncpy(msg.game_name, game_name, MAX_GAME_NAME - 1);
 
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
+  if (receive_reply(socket, &response)) {
     if (response.type == MSG_ACK) {
       current_game_id = response.game_id;
       in_game = true;
-      printf("Game '%s' created successfully (ID: %d)\n", game_name,
-             current_game_id);
+      printf("Game '%s' created successfully (ID: %lld)\n", game_name,
+             (long long)current_game_id);
       return true;
     } else {
-      printf("Failed to create game: %s\n", response.data);
+      printf("Failed to create game: %s\n", status_text(response.status));
       return false;
     }
   }
@@ -114,81 +192,140 @@ bool create_game(void *socket, const char *game_name) {
 bool join_game(void *socket, const char *game_name) {
   Message msg = {0};
   msg.type = MSG_JOIN_GAME;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.session = session;
   strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
   strncpy(msg.game_name, game_name, MAX_GAME_NAME - 1);
 
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
+  if (receive_reply(socket, &response)) {
     if (response.type == MSG_ACK) {
       current_game_id = response.game_id;
       in_game = true;
-      printf("Joined game '%s' successfully (ID: %d)\n", game_name,
-             current_game_id);
-      printf("%s\n", response.data);
+      printf("Joined game '%s' successfully (ID: %lld)\n", game_name,
+             (long long)current_game_id);
+      printf("%s\n", status_text(response.status));
       return true;
     } else {
-      printf("Failed to join game: %s\n", response.data);
+      printf("Failed to join game: %s\n", status_text(response.status));
       return false;
     }
   }
   return false;
 }
 
+static void match_found(const Message *msg) {
+  current_game_id = msg->game_id;
+  in_game = true;
+  printf("Matched with %s in game '%s' (ID: %lld)\n", msg->sender,
+         msg->game_name, (long long)current_game_id);
+  start_placement();
+}
+
+// Быстрая игра: сервер сам подбирает соперника. Если ждущих нет, клиент
+// остаётся в очереди, а пару потом присылает уведомление MSG_QUICK_MATCH.
+void quick_match(void *socket) {
+  Message msg = {0};
+  msg.type = MSG_QUICK_MATCH;
+  msg.session = session;
+  strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
+
+  send_message(socket, &msg);
+
+  Message response = {0};
+  if (!receive_reply(socket, &response)) {
+    return;
+  }
+  if (response.type != MSG_QUICK_MATCH) {
+    printf("Quick match failed: %s\n", status_text(response.status));
+  } else if (response.status == ST_MATCH_QUEUED) {
+    printf("%s...\n", status_text(response.status));
+    set_state(INPUT_WAIT);
+  } else {
+    match_found(&response);
+  }
+}
+
+// Партия против бота сервера: соперник готов сразу, остаётся расставить
+// свой флот
+bool play_bot(void *socket) {
+  Message msg = {0};
+  msg.type = MSG_PLAY_BOT;
+  msg.session = session;
+  strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
+
+  send_message(socket, &msg);
+
+  Message response = {0};
+  if (!receive_reply(socket, &response)) {
+    return false;
+  }
+  if (response.type != MSG_PLAY_BOT) {
+    printf("Cannot start a game with the bot: %s\n",
+           status_text(response.status));
+    return false;
+  }
+
+  current_game_id = response.game_id;
+  in_game = true;
+  printf("Playing against %s in game '%s' (ID: %lld)\n", response.sender,
+         response.game_name, (long long)current_game_id);
+  return true;
+}
+
 bool invite_player(void *socket, const char *player_name) {
   Message msg = {0};
   msg.type = MSG_INVITE_PLAYER;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.session = session;
   strncpy(msg.recipient, player_name, MAX_PLAYER_NAME - 1);
 
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
+  if (receive_reply(socket, &response)) {
     if (response.type == MSG_ACK) {
       printf("Invitation sent to %s\n", player_name);
       return true;
     } else {
-      printf("Failed to invite player: %s\n", response.data);
+      printf("Failed to invite player: %s\n", status_text(response.status));
       return false;
     }
   }
   return false;
 }
 
-bool place_ship_on_board(void *socket, int x, int y, int size, int horizontal) {
+// Вся расстановка уходит одним сообщением; сервер принимает её целиком
+StatusCode send_fleet(void *socket, const uint8_t fleet[MAX_SHIPS]) {
   Message msg = {0};
-  msg.type = MSG_PLACE_SHIP;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.type = MSG_PLACE_FLEET;
+  msg.game_id = current_game_id;
+  msg.session = session;
   strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
-  msg.x = x;
-  msg.y = y;
-  snprintf(msg.data, MAX_MESSAGE_SIZE, "%d,%d,%d,%d", x, y, size, horizontal);
+  memcpy(msg.fleet, fleet, MAX_SHIPS);
 
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
-    if (response.type == MSG_ACK) {
-      if (place_ship(my_board, x, y, size, horizontal)) {
-        printf("Ship placed at (%d,%d) size %d %s\n", x, y, size,
-               horizontal == 1 ? "horizontal" : "vertical");
-        return true;
-      }
-    } else {
-      printf("Failed to place ship: %s\n", response.data);
-      return false;
-    }
+  if (!receive_reply(socket, &response)) {
+    return ST_NONE;
   }
-  return false;
+  if (response.type == MSG_ACK) {
+    printf("%s\n", status_text(response.status));
+  } else if (response.status == ST_INVALID_FLEET) {
+    printf("Ship %d rejected by server: %s\n", response.x + 1,
+           status_text(response.status));
+  } else {
+    printf("Failed to place ships: %s\n", status_text(response.status));
+  }
+  return response.status;
 }
 
 ShotResult make_shot_to_opponent(void *socket, int x, int y) {
   Message msg = {0};
   msg.type = MSG_MAKE_SHOT;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.game_id = current_game_id;
+  msg.session = session;
   strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
   msg.x = x;
   msg.y = y;
@@ -196,142 +333,204 @@ ShotResult make_shot_to_opponent(void *socket, int x, int y) {
   send_message(socket, &msg);
 
   Message response = {0};
-  if (receive_message(socket, &response)) {
+  if (receive_reply(socket, &response)) {
     if (response.type == MSG_SHOT_RESULT) {
-      opponent_shots[x][y] = (response.shot_result == SHOT_MISS) ? 2 : 1;
-      printf("Shot at (%d,%d): %s\n", x, y, response.data);
+      opponent_shots[y][x] = (response.shot_result == SHOT_MISS) ? 2 : 3;
+      printf("Shot at (%d,%d): %s\n", x, y,
+             shot_result_text(response.shot_result));
       return response.shot_result;
     } else if (response.type == MSG_ERROR) {
-      printf("Error: %s\n", response.data);
+      printf("Error: %s\n", status_text(response.status));
       return SHOT_INVALID;
     }
   }
   return SHOT_INVALID;
 }
 
+// Список приходит страницами: x в ответе - курсор следующей, 0 - конец
 void list_games(void *socket) {
   Message msg = {0};
   msg.type = MSG_LIST_GAMES;
-  strncpy(msg.sender, player_login, MAX_PLAYER_NAME - 1);
+  msg.session = session;
   strncpy(msg.recipient, "SERVER", MAX_PLAYER_NAME - 1);
 
-  send_message(socket, &msg);
+  do {
+    send_message(socket, &msg);
 
-  Message response = {0};
-  if (receive_message(socket, &response)) {
-    if (response.type == MSG_LIST_GAMES) {
-      printf("%s\n", response.data);
+    Message response = {0};
+    if (!receive_reply(socket, &response)) {
+      return;
     }
-  }
+    if (response.type != MSG_LIST_GAMES) {
+      printf("%s\n", status_text(response.status));
+      return;
+    }
+    printf("%s", response.data[0] ? response.data
+                                  : status_text(response.status));
+    msg.x = response.x;
+  } while (msg.x != 0);
+  printf("\n");
 }
 
-void place_ships_manually(void *socket) {
+static void place_ships_manually(void) {
   printf("You need to place ships. Format: x y size horizontal(1/0)\n");
   printf("Example: 0 0 4 1 (places 4-cell ship at (0,0) horizontally)\n");
   printf("Ships: 1x4, 2x3, 3x2, 4x1\n");
-
-  int ships[] = {4, 3, 3, 2, 2, 2, 1, 1, 1, 1};
-  int placed = 0;
-
   init_board(my_board);
-
-  while (placed < MAX_SHIPS) {
-    printf("\nYour board:\n");
-    print_board(my_board, true);
-    printf("\nPlace ship %d/%d (size %d): ", placed + 1, MAX_SHIPS,
-           ships[placed]);
-
-    int x, y, size, h;
-    if (scanf("%d %d %d %d", &x, &y, &size, &h) == 4) {
-      if (size != ships[placed]) {
-        printf("Wrong ship size! Expected %d\n", ships[placed]);
-        continue;
-      }
-
-      if (place_ship_on_board(socket, x, y, size, h)) {
-        placed++;
-      }
-    } else {
-      printf("Invalid input. Try again.\n");
-      while (getchar() != '\n')
-        ; // Очистка буфера
-    }
-  }
-
-  printf("\nAll ships placed!\n");
-  printf("Your final board:\n");
-  print_board(my_board, true);
+  ships_placed = 0;
+  set_state(INPUT_SHIP);
 }
 
-void auto_place_ships(void *socket) {
+void auto_place_ships(uint8_t fleet[MAX_SHIPS]) {
   printf("Auto placing ships: 1x4, 2x3, 3x2, 4x1\n");
-  int ships[] = {4, 3, 3, 2, 2, 2, 1, 1, 1, 1};
-  int placed = 0;
+  fleet_random(fleet, &placement_rng);
 
   init_board(my_board);
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int cell = fleet[i] & ~FLEET_HORIZONTAL;
+    place_ship(my_board, cell % BOARD_SIZE, cell / BOARD_SIZE, fleet_sizes[i],
+               (fleet[i] & FLEET_HORIZONTAL) ? 1 : 0);
+  }
 
-  srand(time(NULL));
+  printf("All ships placed automatically!\n");
+  print_board(my_board, true);
+}
 
-  while (placed < MAX_SHIPS) {
-    int size = ships[placed];
+void request_game_state(void *socket) {
+  Message req = {0};
+  req.type = MSG_GAME_STATE;
+  req.game_id = current_game_id;
+  req.session = session;
+  send_message(socket, &req);
+}
 
-    int x = rand() % BOARD_SIZE;
-    int y = rand() % BOARD_SIZE;
-    int h = rand() % 2;
+// Ход определяет сервер: после начала партии и после каждого выстрела он
+// присылает MSG_GAME_STATE обоим игрокам, клиент просто ждёт событий
+static void start_game(void *socket) {
+  printf("\n=== Game Started ===\n");
+  game_started = true;
+  my_turn = false;
+  set_state(INPUT_WAIT);
+  request_game_state(socket);
+}
 
-    if (place_ship_on_board(socket, x, y, size, h)) {
-      placed++;
-    }
+// Расстановка pending_fleet. Отказ сервера в самой расстановке - повтор
+// тем же способом, прочие ошибки возвращают в меню.
+static void submit_fleet(void *socket) {
+  set_state(INPUT_MENU);
+  StatusCode status = send_fleet(socket, pending_fleet);
+  if (status == ST_FLEET_PLACED) {
+    start_game(socket);
+  } else if (status == ST_INVALID_FLEET && auto_placement) {
+    auto_place_ships(pending_fleet);
+    submit_fleet(socket);
+  } else if (status == ST_INVALID_FLEET) {
+    place_ships_manually();
   }
+}
 
-  printf("All ships placed automatically!\n");
+static void handle_placement_mode(void *socket, const char *line) {
+  int answer = parse_yes_no(line, true);
+  if (answer < 0) {
+    prompt_needed = true;
+    return;
+  }
+  auto_placement = answer;
+  if (auto_placement) {
+    auto_place_ships(pending_fleet);
+    submit_fleet(socket);
+  } else {
+    place_ships_manually();
+  }
 }
 
-void select_ships_placement_mode(void *socket) {
-  printf("\n=== Placing Ships ===\n");
-  bool autoPlacement =
-      ask_yes_no("Whould you like to try auto ship placement?", true);
-  if (autoPlacement) {
-    auto_place_ships(socket);
+static void handle_ship(void *socket, const char *line) {
+  int x, y, size, h;
+  prompt_needed = true;
+  if (sscanf(line, "%d %d %d %d", &x, &y, &size, &h) != 4) {
+    printf("Invalid input. Try again.\n");
+  } else if (size != fleet_sizes[ships_placed]) {
+    printf("Wrong ship size! Expected %d\n", fleet_sizes[ships_placed]);
+  } else if (!place_ship(my_board, x, y, size, h)) {
+    printf("Invalid placement. Try again.\n");
   } else {
-    place_ships_manually(socket);
+    pending_fleet[ships_placed++] = fleet_pack(x, y, h);
+  }
+
+  if (ships_placed == MAX_SHIPS) {
+    printf("\nAll ships placed!\n");
+    printf("Your final board:\n");
+    print_board(my_board, true);
+    submit_fleet(socket);
   }
 }
 
-void request_game_state(void *socket) {
-  Message req = {0};
-  req.type = MSG_GAME_STATE;
-  strncpy(req.sender, player_login, MAX_PLAYER_NAME - 1);
-  send_message(socket, &req);
+static void handle_shot(void *socket, const char *line) {
+  int x, y;
+  if (sscanf(line, "%d %d", &x, &y) != 2) {
+    printf("Invalid input.\n");
+    prompt_needed = true;
+    return;
+  }
+  // Ждём от сервера, чей ход следующий; уведомления, пришедшие вместе
+  // с ответом, могут сменить состояние
+  set_state(INPUT_WAIT);
+  if (make_shot_to_opponent(socket, x, y) == SHOT_INVALID &&
+      input_state == INPUT_WAIT) {
+    printf("Invalid shot. Try again.\n");
+    set_state(INPUT_SHOT);
+  } else {
+    my_turn = false;
+  }
 }
 
-void handle_server_response(void *socket, Message *msg) {
+static void handle_server_response(const Message *msg) {
   if (msg->type == MSG_SHOT_RESULT) {
-    if (strcmp(msg->recipient, player_login) == 0) {
-      printf("Opponent shot at (%d,%d): %s\n", msg->x, msg->y, msg->data);
-      if (msg->shot_result == SHOT_MISS) {
-        my_turn = true;
+    if (msg->status == ST_OPPONENT_SHOT) {
+      printf("Opponent shot at (%d,%d): %s\n", msg->x, msg->y,
+             shot_result_text(msg->shot_result));
+      if (msg->x >= 0 && msg->x < BOARD_SIZE && msg->y >= 0 &&
+          msg->y < BOARD_SIZE) {
+        my_board[msg->y][msg->x] = (msg->shot_result == SHOT_MISS) ? 2 : 3;
       }
     }
   } else if (msg->type == MSG_GAME_STATE) {
-    printf("[GAME STATE] %s\n", msg->data);
-
-    my_turn = (strcmp(msg->data, "Your turn!") == 0);
+    printf("[GAME STATE] %s\n", status_text(msg->status));
 
+    my_turn = (msg->status == ST_YOUR_TURN);
+    if (game_started) {
+      set_state(my_turn ? INPUT_SHOT : INPUT_WAIT);
+    }
   } else if (msg->type == MSG_GAME_OVER) {
     printf("\n=== GAME OVER ===\n");
-    printf("%s\n", msg->data);
+    printf("%s\n", status_text(msg->status));
     game_started = false;
     in_game = false;
-    return;
+    my_turn = false;
+    set_state(INPUT_MENU);
   } else if (msg->type == MSG_INVITE_PLAYER) {
     printf("\n=== INVITATION ===\n");
-    printf("%s\n", msg->data);
-    printf("Do you want to join game '%s'? (y/n): ", msg->game_name);
-    char answer;
-    scanf(" %c", &answer);
-    if (answer == 'y' || answer == 'Y') {
-      join_game(socket, msg->game_name);
+    printf("%s invites you to game '%s'\n", msg->sender, msg->game_name);
+    // Недописанный ответ на другой вопрос не сбиваем
+    if (input_state == INPUT_MENU && !in_game) {
+      strncpy(pending_name, msg->game_name, MAX_GAME_NAME - 1);
+      set_state(INPUT_INVITATION);
+    } else if (!in_game) {
+      printf("Use 'Join game' to accept it.\n");
+    }
+  } else if (msg->type == MSG_ACK && msg->status == ST_OPPONENT_JOINED) {
+    printf("\n%s\n", status_text(msg->status));
+    if (in_game && !game_started && input_state == INPUT_MENU) {
+      start_placement();
+    } else if (in_game && !game_started) {
+      printf("Use 'Start game' to place your ships.\n");
+    }
+  } else if (msg->type == MSG_QUICK_MATCH) {
+    if (msg->status == ST_OPPONENT_JOINED) {
+      match_found(msg);
+    } else {
+      printf("%s\n", status_text(msg->status));
+      set_state(INPUT_MENU);
     }
   }
 }
@@ -339,56 +538,126 @@ void handle_server_response(void *socket, Message *msg) {
 void process_incoming(void *socket) {
   Message msg;
   while (receive_message_nonblock(socket, &msg)) {
-    handle_server_response(socket, &msg);
+    handle_server_response(&msg);
   }
 }
 
-void game_loop(void *socket) {
-  printf("\n=== Game Started ===\n");
-  game_started = true;
+// Клетки снимка трансляции: '.', 'o' - промах, 'x' - попадание
+static void load_spectator_board(int board[BOARD_SIZE][BOARD_SIZE],
+                                 const char *cells) {
+  for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; cell++) {
+    int v = cells[cell] == 'o' ? 2 : cells[cell] == 'x' ? 3 : 0;
+    board[cell / BOARD_SIZE][cell % BOARD_SIZE] = v;
+  }
+}
 
-  // printf("pr_rgs\n");
-  request_game_state(socket);
-  // printf("pst_rgs\n");
+// Режим зрителя: подписка на трансляцию партии. Сначала приходит
+// снимок обоих полей (корабли не видны), затем выстрелы по одному.
+// В терминале доски стоят на месте и перерисовываются только
+// изменившиеся клетки (screen_draw), иначе кадры идут друг за другом.
+static int spectate(void *context, int64_t game_id) {
+  void *socket = zmq_socket(context, ZMQ_SUB);
+  char address[100];
+  snprintf(address, sizeof(address), "tcp://localhost:%s", SPECTATOR_PORT);
+  if (zmq_connect(socket, address) != 0) {
+    fprintf(stderr, "Error connecting to server: %s\n", zmq_strerror(errno));
+    return 1;
+  }
+  uint8_t topic[SPECTATOR_TOPIC_SIZE];
+  spectator_topic(game_id, topic);
+  zmq_setsockopt(socket, ZMQ_SUBSCRIBE, topic, sizeof(topic));
+  printf("Watching game %lld, waiting for the game to start...\n",
+         (long long)game_id);
+
+  char names[MAX_PLAYERS][MAX_PLAYER_NAME] = {{0}};
+  int boards[MAX_PLAYERS][BOARD_SIZE][BOARD_SIZE];
+  init_board(boards[0]);
+  init_board(boards[1]);
+  int turn = 0;
+  bool over = false;
+
+  bool live = isatty(STDOUT_FILENO);
+  Screen screen;
+  screen_init(&screen);
+  // Строки длиннее ширины экрана screen_draw обрежет
+  char header[MAX_GAME_NAME + 2 * MAX_PLAYER_NAME + 16] = "";
+  char event[MAX_PLAYER_NAME + 64] = "";
+
+  while (!over) {
+    uint8_t frame[SPECTATOR_TOPIC_SIZE];
+    Message msg;
+    if (zmq_recv(socket, frame, sizeof(frame), 0) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (!receive_message(socket, &msg)) {
+      continue;
+    }
 
-  while (game_started) {
-    printf("\n");
-    print_boards_side_by_side(my_board, opponent_shots);
-    // printf("Your board (ships visible):\n");
-    // print_board(my_board, true);
-    // printf("\nOpponent board (shots only):\n");
-    // print_board(opponent_shots, false);
-    Message msg = {0};
-
-    if (my_turn) {
-      printf("\nYour turn! Enter coordinates (x y): ");
-      int x, y;
-      if (scanf("%d %d", &x, &y) == 2) {
-        ShotResult result = make_shot_to_opponent(socket, x, y);
-        if (result == SHOT_MISS) {
-          my_turn = false;
-        } else if (result == SHOT_INVALID) {
-          printf("Invalid shot. Try again.\n");
-        }
+    if (msg.type == MSG_GAME_STATE) {
+      strncpy(names[0], msg.sender, MAX_PLAYER_NAME - 1);
+      strncpy(names[1], msg.recipient, MAX_PLAYER_NAME - 1);
+      load_spectator_board(boards[0], msg.data);
+      load_spectator_board(boards[1], msg.data + BOARD_SIZE * BOARD_SIZE);
+      turn = msg.x == 1;
+      snprintf(header, sizeof(header), "=== %s: %s vs %s ===", msg.game_name,
+               names[0], names[1]);
+      event[0] = '\0';
+    } else if (msg.type == MSG_SHOT_RESULT && names[0][0] != '\0') {
+      int target = strcmp(msg.recipient, names[1]) == 0;
+      if (msg.x >= 0 && msg.x < BOARD_SIZE && msg.y >= 0 &&
+          msg.y < BOARD_SIZE) {
+        boards[target][msg.y][msg.x] = msg.shot_result == SHOT_MISS ? 2 : 3;
+      }
+      turn = msg.shot_result == SHOT_MISS ? target : 1 - target;
+      snprintf(event, sizeof(event), "%s shot at (%d,%d): %s", msg.sender,
+               msg.x, msg.y, shot_result_text(msg.shot_result));
+    } else if (msg.type == MSG_GAME_OVER) {
+      if (msg.sender[0] != '\0') {
+        snprintf(event, sizeof(event), "=== GAME OVER === %s won",
+                 msg.sender);
       } else {
-        printf("Invalid input.\n");
-        while (getchar() != '\n')
-          ;
+        snprintf(event, sizeof(event), "=== GAME OVER === Game abandoned");
       }
+      over = true;
     } else {
-      // printf("\nWaiting for opponent's turn...\n");
+      continue;
+    }
 
-      printf("%s\n", msg.data);
-      sleep(1);
-      request_game_state(socket);
+    if (!live) {
+      printf("\n%s\n", msg.type == MSG_GAME_STATE ? header : event);
+    }
+    if (names[0][0] == '\0') {
+      continue;
     }
 
-    // Проверка сообщений от сервера
-    if (receive_message_nonblock(socket, &msg)) {
-      printf("%s\n", msg.data);
-      handle_server_response(socket, &msg);
+    char turn_line[MAX_PLAYER_NAME + 8] = "";
+    if (!over) {
+      snprintf(turn_line, sizeof(turn_line), "Turn: %s", names[turn]);
+    }
+    if (live) {
+      char titles[MAX_PLAYERS][MAX_PLAYER_NAME + 16];
+      for (int i = 0; i < MAX_PLAYERS; i++) {
+        snprintf(titles[i], sizeof(titles[i]), "%.*s's board",
+                 MAX_PLAYER_NAME - 1, names[i]);
+      }
+      const char *title_lines[SCREEN_BOARDS] = {titles[0], titles[1]};
+      const char *text_lines[SCREEN_LINES] = {header, event, turn_line};
+      screen_draw(&screen, boards, title_lines, text_lines);
+      continue;
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+      printf("\n%s's board:\n", names[i]);
+      print_board(boards[i], false);
+    }
+    if (!over) {
+      printf("%s\n", turn_line);
     }
   }
+
+  zmq_close(socket);
+  return 0;
 }
 
 void show_menu() {
@@ -398,21 +667,257 @@ void show_menu() {
   printf("3. Invite player\n");
   printf("4. List games\n");
   printf("5. Start game (if in game)\n");
-  printf("6. Exit\n");
+  printf("6. Quick match\n");
+  printf("7. Play against the server bot\n");
+  printf("8. Exit\n");
   printf("Choice: ");
 }
 
+static void show_prompt(void) {
+  switch (input_state) {
+  case INPUT_MENU:
+    show_menu();
+    break;
+  case INPUT_GAME_NAME:
+  case INPUT_JOIN_NAME:
+    printf("Enter game name: ");
+    break;
+  case INPUT_TURN_LIMIT:
+    printf("Seconds per turn (0 - server default): ");
+    break;
+  case INPUT_INVITE_LOGIN:
+    printf("Enter player login to invite: ");
+    break;
+  case INPUT_INVITATION:
+    printf("Do you want to join game '%s'? (y/n): ", pending_name);
+    break;
+  case INPUT_PLACEMENT_MODE:
+    printf("Whould you like to try auto ship placement? [Y/n]: ");
+    break;
+  case INPUT_SHIP:
+    printf("\nYour board:\n");
+    print_board(my_board, true);
+    printf("\nPlace ship %d/%d (size %d): ", ships_placed + 1, MAX_SHIPS,
+           fleet_sizes[ships_placed]);
+    break;
+  case INPUT_SHOT:
+    printf("\n");
+    print_boards_side_by_side(my_board, opponent_shots);
+    printf("\nYour turn! Enter coordinates (x y): ");
+    break;
+  case INPUT_WAIT:
+    break;
+  }
+  fflush(stdout);
+}
+
+static void logout(void *socket) {
+  printf("Exiting...\n");
+  Message msg = {0};
+  msg.type = MSG_LOGOUT;
+  msg.session = session;
+  send_message(socket, &msg);
+}
+
+// false - пользователь выбрал выход
+static bool handle_menu(void *socket, const char *line) {
+  int choice;
+  set_state(INPUT_MENU);
+  if (sscanf(line, "%d", &choice) != 1) {
+    printf("Invalid input.\n");
+    return true;
+  }
+
+  switch (choice) {
+  case 1:
+    set_state(INPUT_GAME_NAME);
+    break;
+  case 2:
+    set_state(INPUT_JOIN_NAME);
+    break;
+  case 3:
+    if (!in_game) {
+      printf("You are not in a game.\n");
+    } else {
+      set_state(INPUT_INVITE_LOGIN);
+    }
+    break;
+  case 4:
+    list_games(socket);
+    break;
+  case 5:
+    if (in_game && !game_started) {
+      start_placement();
+    } else if (!in_game) {
+      printf("You are not in a game.\n");
+    } else {
+      printf("Game already started.\n");
+    }
+    break;
+  case 6:
+    if (in_game) {
+      printf("You are already in a game.\n");
+    } else {
+      quick_match(socket);
+    }
+    break;
+  case 7:
+    if (in_game) {
+      printf("You are already in a game.\n");
+    } else if (play_bot(socket)) {
+      start_placement();
+    }
+    break;
+  case 8:
+    logout(socket);
+    return false;
+  default:
+    printf("Invalid choice.\n");
+    break;
+  }
+  return true;
+}
+
+// Разбор одной строки ввода по текущему состоянию; false - выход
+static bool handle_line(void *socket, const char *line) {
+  char word[MAX_GAME_NAME];
+  int answer;
+
+  switch (input_state) {
+  case INPUT_MENU:
+    return handle_menu(socket, line);
+  case INPUT_GAME_NAME:
+    if (first_word(line, pending_name, sizeof(pending_name))) {
+      set_state(INPUT_TURN_LIMIT);
+    } else {
+      prompt_needed = true;
+    }
+    break;
+  case INPUT_TURN_LIMIT: {
+    int turn_limit = 0;
+    if (sscanf(line, "%d", &turn_limit) != 1) {
+      turn_limit = 0;
+    }
+    set_state(INPUT_MENU);
+    create_game(socket, pending_name, turn_limit);
+    break;
+  }
+  case INPUT_JOIN_NAME:
+    if (!first_word(line, word, sizeof(word))) {
+      prompt_needed = true;
+      break;
+    }
+    set_state(INPUT_MENU);
+    if (join_game(socket, word)) {
+      start_placement();
+    }
+    break;
+  case INPUT_INVITE_LOGIN:
+    if (!first_word(line, word, sizeof(word))) {
+      prompt_needed = true;
+      break;
+    }
+    set_state(INPUT_MENU);
+    invite_player(socket, word);
+    break;
+  case INPUT_INVITATION:
+    answer = parse_yes_no(line, false);
+    if (answer < 0) {
+      prompt_needed = true;
+      break;
+    }
+    set_state(INPUT_MENU);
+    if (answer && join_game(socket, pending_name)) {
+      start_placement();
+    }
+    break;
+  case INPUT_PLACEMENT_MODE:
+    handle_placement_mode(socket, line);
+    break;
+  case INPUT_SHIP:
+    handle_ship(socket, line);
+    break;
+  case INPUT_SHOT:
+    handle_shot(socket, line);
+    break;
+  case INPUT_WAIT:
+    printf(game_started ? "Wait for your turn.\n"
+                        : "Waiting for an opponent...\n");
+    break;
+  }
+  return true;
+}
+
+// Дочитывает stdin, сколько есть, и отдаёт целые строки handle_line.
+// false - конец ввода или выход из меню.
+static bool read_input(void *socket) {
+  ssize_t n = read(STDIN_FILENO, input_line + input_len,
+                   sizeof(input_line) - 1 - input_len);
+  if (n < 0) {
+    return errno == EINTR || errno == EAGAIN;
+  }
+  if (n == 0) {
+    // Последняя строка без перевода строки
+    input_line[input_len] = '\0';
+    if (input_len == 0 || handle_line(socket, input_line)) {
+      logout(socket);
+    }
+    return false;
+  }
+
+  size_t start = 0;
+  for (size_t i = input_len; i < input_len + (size_t)n; i++) {
+    if (input_line[i] != '\n') {
+      continue;
+    }
+    input_line[i] = '\0';
+    if (i > start && input_line[i - 1] == '\r') {
+      input_line[i - 1] = '\0';
+    }
+    if (!handle_line(socket, input_line + start)) {
+      return false;
+    }
+    start = i + 1;
+  }
+  input_len += (size_t)n - start;
+  memmove(input_line, input_line + start, input_len);
+
+  // Строка длиннее буфера разбирается по частям
+  if (input_len == sizeof(input_line) - 1) {
+    input_line[input_len] = '\0';
+    input_len = 0;
+    return handle_line(socket, input_line);
+  }
+  return true;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc < 2) {
+  if (argc < 2 || (strcmp(argv[1], "--watch") == 0 && argc < 3)) {
     printf("Usage: %s <login>\n", argv[0]);
+    printf("       %s --watch <game id>\n", argv[0]);
     return 1;
   }
 
+  if (strcmp(argv[1], "--watch") == 0) {
+    void *context = zmq_ctx_new();
+    int rc = spectate(context, strtoll(argv[2], NULL, 10));
+    zmq_ctx_destroy(context);
+    return rc;
+  }
+
   const char *login = argv[1];
 
+  // SEABATTLE_SEED задаёт повторяемую автоматическую расстановку
+  const char *seed = getenv("SEABATTLE_SEED");
+  placement_rng = seed != NULL ? (uint32_t)strtoul(seed, NULL, 0)
+                               : (uint32_t)time(NULL) ^ (uint32_t)getpid();
+  if (placement_rng == 0) {
+    placement_rng = 1;
+  }
+
   void *context = zmq_ctx_new();
   void *socket = zmq_socket(context, ZMQ_DEALER);
-  zmq_setsockopt(socket, ZMQ_IDENTITY, player_login, strlen(player_login));
+  zmq_setsockopt(socket, ZMQ_IDENTITY, login, strlen(login));
 
   char address[100];
   snprintf(address, sizeof(address), "tcp://localhost:%s", SERVER_PORT);
@@ -435,96 +940,29 @@ int main(int argc, char *argv[]) {
   init_board(my_board);
   init_board(opponent_shots);
 
-  // Главный цикл
-  while (1) {
-    show_menu();
-    int choice;
-    if (scanf("%d", &choice) != 1) {
-      printf("Invalid input.\n");
-      while (getchar() != '\n')
-        ;
-      continue;
-    }
-
-    switch (choice) {
-    case 1: {
-      char game_name[MAX_GAME_NAME];
-      printf("Enter game name: ");
-      scanf("%s", game_name);
-      create_game(socket, game_name);
-      break;
-    }
-    case 2: {
-      char game_name[MAX_GAME_NAME];
-      printf("Enter game name: ");
-      scanf("%s", game_name);
-      if (join_game(socket, game_name)) {
-        select_ships_placement_mode(socket);
-        game_loop(socket);
-      }
-      break;
-    }
-    case 3: {
-      if (!in_game) {
-        printf("You are not in a game.\n");
-        break;
-      }
-      char player_name[MAX_PLAYER_NAME];
-      printf("Enter player login to invite: ");
-      scanf("%s", player_name);
-      invite_player(socket, player_name);
-      break;
-    }
-    case 4: {
-      list_games(socket);
-      break;
+  // Главный цикл: ждём сразу и сервер, и stdin. Уведомления (приглашение,
+  // смена хода, конец игры) обрабатываются, как только пришли, а не
+  // после следующего Enter.
+  zmq_pollitem_t items[2] = {{socket, 0, ZMQ_POLLIN, 0},
+                             {NULL, STDIN_FILENO, ZMQ_POLLIN, 0}};
+  bool running = true;
+  while (running) {
+    if (prompt_needed) {
+      prompt_needed = false;
+      show_prompt();
     }
-    case 5: {
-      if (in_game && !game_started) {
-        select_ships_placement_mode(socket);
-        game_loop(socket);
-      } else if (!in_game) {
-        printf("You are not in a game.\n");
-      } else {
-        printf("Game already started.\n");
-      }
+    if (zmq_poll(items, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
       break;
     }
-    case 6: {
-      printf("Exiting...\n");
-      zmq_close(socket);
-      zmq_ctx_destroy(context);
-      return 0;
+    if (items[0].revents & ZMQ_POLLIN) {
+      process_incoming(socket);
     }
-    default:
-      printf("Invalid choice.\n");
-      break;
-    }
-
-    // Проверка входящих сообщений (приглашения и т.д.)
-    Message msg = {0};
-    if (receive_message_nonblock(socket, &msg)) {
-      if (msg.type == MSG_INVITE_PLAYER) {
-        printf("\n=== INVITATION ===\n");
-        printf("%s\n", msg.data);
-        printf("Do you want to join game '%s'? (y/n): ", msg.game_name);
-        char answer;
-        scanf(" %c", &answer);
-        if (answer == 'y' || answer == 'Y') {
-          if (join_game(socket, msg.game_name)) {
-            select_ships_placement_mode(socket);
-            game_loop(socket);
-          }
-        }
-      } else if (msg.type == MSG_ACK && in_game && !game_started) {
-        if (strstr(msg.data, "joined") != NULL ||
-            strstr(msg.data, "Start placing") != NULL) {
-          printf("%s\n", msg.data);
-          select_ships_placement_mode(socket);
-          game_loop(socket);
-        }
-      }
+    if (items[1].revents & ZMQ_POLLIN) {
+      running = read_input(socket);
     }
+    fflush(stdout);
   }
 
   zmq_close(socket);
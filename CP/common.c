@@ -1,255 +1,386 @@
 #include "common.h"
+#include "protocol.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 // Отправка сообщения
 int send_message(void *socket, Message *msg) {
-  int size = zmq_send(socket, msg, sizeof(Message), 0);
-  return size == sizeof(Message);
+  uint8_t buf[PROTO_MAX_FRAME];
+  size_t len = proto_encode(msg, buf, sizeof(buf));
+  if (len == 0) {
+    return 0;
+  }
+  return zmq_send(socket, buf, len, 0) == (int)len;
+}
+
+static int receive_frame(void *socket, Message *msg, int flags) {
+  uint8_t buf[PROTO_MAX_FRAME];
+  int size = zmq_recv(socket, buf, sizeof(buf), flags);
+  if (size <= 0 || (size_t)size > sizeof(buf)) {
+    return 0;
+  }
+  return proto_decode(buf, (size_t)size, msg);
 }
 
 // Получение сообщения (блокирующее)
 int receive_message(void *socket, Message *msg) {
-  int size = zmq_recv(socket, msg, sizeof(Message), 0);
-  return size == sizeof(Message);
+  return receive_frame(socket, msg, 0);
 }
 
 // Получение сообщения (неблокирующее)
 int receive_message_nonblock(void *socket, Message *msg) {
-  int size = zmq_recv(socket, msg, sizeof(Message), ZMQ_DONTWAIT);
-  return size == sizeof(Message);
+  return receive_frame(socket, msg, ZMQ_DONTWAIT);
 }
 
-// Инициализация доски
-void init_board(int board[BOARD_SIZE][BOARD_SIZE]) {
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      board[i][j] = 0;
-    }
+#define CELL_COUNT (BOARD_SIZE * BOARD_SIZE)
+#define MAX_SHIP_SIZE 4
+
+static const Bitboard BB_FULL = {~0ull, (1ull << (CELL_COUNT - 64)) - 1};
+
+static inline Bitboard bb_cell(int cell) {
+  Bitboard b = {0, 0};
+  if (cell < 64) {
+    b.lo = 1ull << cell;
+  } else {
+    b.hi = 1ull << (cell - 64);
   }
+  return b;
 }
 
-// Проверка валидности размещения корабля
-bool is_valid_placement(int board[BOARD_SIZE][BOARD_SIZE], int x, int y,
-                        int size, int horizontal) {
-  if (x < 0 || y < 0)
-    return false;
+static inline Bitboard bb_or(Bitboard a, Bitboard b) {
+  return (Bitboard){a.lo | b.lo, a.hi | b.hi};
+}
 
-  if (horizontal == 1) {
-    if (x + size > BOARD_SIZE)
-      return false;
+static inline Bitboard bb_and(Bitboard a, Bitboard b) {
+  return (Bitboard){a.lo & b.lo, a.hi & b.hi};
+}
 
-    for (int row = y - 1; row <= y + 1; row++) {
-      for (int col = x - 1; col <= x + size; col++) {
-        if (row >= 0 && row < BOARD_SIZE && col >= 0 && col < BOARD_SIZE) {
-          if (board[row][col] == 1) {
-            // printf("h conflict at %d %d\n", row, col);
-            return false;
-          }
-        }
+static inline Bitboard bb_andnot(Bitboard a, Bitboard b) {
+  return (Bitboard){a.lo & ~b.lo, a.hi & ~b.hi};
+}
+
+static inline bool bb_empty(Bitboard b) { return (b.lo | b.hi) == 0; }
+
+static inline bool bb_equal(Bitboard a, Bitboard b) {
+  return a.lo == b.lo && a.hi == b.hi;
+}
+
+static inline bool bb_test(Bitboard b, int cell) {
+  return cell < 64 ? (b.lo >> cell) & 1 : (b.hi >> (cell - 64)) & 1;
+}
+
+// Сдвиги на n клеток, 0 < n < 64
+static inline Bitboard bb_shl(Bitboard b, int n) {
+  return (Bitboard){b.lo << n, (b.hi << n) | (b.lo >> (64 - n))};
+}
+
+static inline Bitboard bb_shr(Bitboard b, int n) {
+  return (Bitboard){(b.lo >> n) | (b.hi << (64 - n)), b.hi >> n};
+}
+
+// Маски столбцов: все клетки, кроме крайнего левого / правого
+static Bitboard not_first_column, not_last_column;
+
+// Клетки вместе с соседями (по 8 направлениям)
+static Bitboard bb_dilate(Bitboard b) {
+  Bitboard row = bb_or(b, bb_and(bb_shl(b, 1), not_first_column));
+  row = bb_or(row, bb_and(bb_shr(b, 1), not_last_column));
+  Bitboard all = bb_or(row, bb_or(bb_shl(row, BOARD_SIZE),
+                                  bb_shr(row, BOARD_SIZE)));
+  return bb_and(all, BB_FULL);
+}
+
+// Заранее посчитанные маски для каждой позиции корабля:
+// клетки корабля и клетки вместе с ореолом. Пустая маска корабля -
+// корабль не помещается на поле.
+typedef struct {
+  Bitboard ship;
+  Bitboard halo;
+} Placement;
+
+static Placement placements[2][MAX_SHIP_SIZE][CELL_COUNT];
+// Клетки, от которых корабль помещается на поле
+static Bitboard anchors[2][MAX_SHIP_SIZE];
+// Номер k-го (с нуля) установленного бита в байте
+static uint8_t byte_select[256][8];
+static pthread_once_t placements_once = PTHREAD_ONCE_INIT;
+
+static void init_placements(void) {
+  for (int cell = 0; cell < CELL_COUNT; cell++) {
+    Bitboard b = bb_cell(cell);
+    if (cell % BOARD_SIZE != 0) {
+      not_first_column = bb_or(not_first_column, b);
+    }
+    if (cell % BOARD_SIZE != BOARD_SIZE - 1) {
+      not_last_column = bb_or(not_last_column, b);
+    }
+  }
+
+  for (int byte = 0; byte < 256; byte++) {
+    int k = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      if (byte & (1 << bit)) {
+        byte_select[byte][k++] = (uint8_t)bit;
       }
     }
-  } else {
-    if (y + size > BOARD_SIZE)
-      return false;
+  }
 
-    for (int row = y - 1; row <= y + size; row++) {
-      for (int col = x - 1; col <= x + 1; col++) {
-        if (row >= 0 && row < BOARD_SIZE && col >= 0 && col < BOARD_SIZE) {
-          if (board[row][col] == 1) {
-            // printf("nh conflict at %d %d", row, col);
-            return false;
+  for (int h = 0; h < 2; h++) {
+    for (int size = 1; size <= MAX_SHIP_SIZE; size++) {
+      for (int y = 0; y < BOARD_SIZE; y++) {
+        for (int x = 0; x < BOARD_SIZE; x++) {
+          if ((h ? x : y) + size > BOARD_SIZE) {
+            continue;
+          }
+          Placement *p = &placements[h][size - 1][y * BOARD_SIZE + x];
+          for (int i = 0; i < size; i++) {
+            int cell = h ? y * BOARD_SIZE + x + i : (y + i) * BOARD_SIZE + x;
+            p->ship = bb_or(p->ship, bb_cell(cell));
           }
+          p->halo = bb_dilate(p->ship);
+          anchors[h][size - 1] =
+              bb_or(anchors[h][size - 1], bb_cell(y * BOARD_SIZE + x));
         }
       }
     }
   }
+}
 
-  return true;
+static void init_tables(void) {
+  pthread_once(&placements_once, init_placements);
 }
 
-// Размещение корабля
-bool place_ship(int board[BOARD_SIZE][BOARD_SIZE], int x, int y, int size,
-                int horizontal) {
-  if (!is_valid_placement(board, x, y, size, horizontal)) {
+static const Placement *find_placement(int x, int y, int size,
+                                       int horizontal) {
+  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE || size < 1 ||
+      size > MAX_SHIP_SIZE) {
+    return NULL;
+  }
+  init_tables();
+  const Placement *p =
+      &placements[horizontal == 1][size - 1][y * BOARD_SIZE + x];
+  return bb_empty(p->ship) ? NULL : p;
+}
+
+void board_clear(Board *board) { memset(board, 0, sizeof(*board)); }
+
+bool board_can_place(const Board *board, int x, int y, int size,
+                     int horizontal) {
+  const Placement *p = find_placement(x, y, size, horizontal);
+  return p != NULL && board->ship_count < MAX_SHIPS &&
+         bb_empty(bb_and(p->halo, board->ships));
+}
+
+bool board_place_ship(Board *board, int x, int y, int size, int horizontal) {
+  if (!board_can_place(board, x, y, size, horizontal)) {
     return false;
   }
+  const Placement *p = find_placement(x, y, size, horizontal);
+  int ship = board->ship_count++;
+  board->ships = bb_or(board->ships, p->ship);
+  board->ship_cells[ship] = p->ship;
+  board->hits_left[ship] = (uint8_t)size;
+  for (int i = 0; i < size; i++) {
+    int cell = horizontal == 1 ? y * BOARD_SIZE + x + i
+                               : (y + i) * BOARD_SIZE + x;
+    board->ship_at[cell] = (uint8_t)(ship + 1);
+  }
+  return true;
+}
 
-  if (horizontal == 1) {
-    for (int i = 0; i < size; i++) {
-      board[y][x + i] = 1;
-    }
-  } else {
-    for (int i = 0; i < size; i++) {
-      board[y + i][x] = 1;
+const int fleet_sizes[MAX_SHIPS] = {4, 3, 3, 2, 2, 2, 1, 1, 1, 1};
+
+bool board_place_fleet(Board *board, const uint8_t fleet[MAX_SHIPS],
+                       int *bad_ship) {
+  Board placed;
+  board_clear(&placed);
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int cell = fleet[i] & ~FLEET_HORIZONTAL;
+    int horizontal = (fleet[i] & FLEET_HORIZONTAL) ? 1 : 0;
+    if (cell >= CELL_COUNT ||
+        !board_place_ship(&placed, cell % BOARD_SIZE, cell / BOARD_SIZE,
+                          fleet_sizes[i], horizontal)) {
+      *bad_ship = i;
+      return false;
     }
   }
-
+  *board = placed;
   return true;
 }
 
-// Выстрел
-ShotResult make_shot(int board[BOARD_SIZE][BOARD_SIZE],
-                     int shots[BOARD_SIZE][BOARD_SIZE], int x, int y) {
-  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
-    return SHOT_INVALID;
-  }
+// Флот на случай, если случайная расстановка раз за разом заходит в
+// тупик (на деле такого не бывает): корабли в рядах 0, 2 и 4
+#define FLEET_RANDOM_ATTEMPTS 64
+static const uint8_t fallback_fleet[MAX_SHIPS] = {
+    FLEET_HORIZONTAL | 0,  FLEET_HORIZONTAL | 5,  FLEET_HORIZONTAL | 20,
+    FLEET_HORIZONTAL | 24, FLEET_HORIZONTAL | 27, FLEET_HORIZONTAL | 40,
+    43, 45, 47, 49};
 
-  if (shots[x][y] != 0) {
-    return SHOT_INVALID;
-  }
+// Номер k-й (с нуля) клетки маски, без ветвлений. Умножение на BYTE_ONES
+// даёт в байте i число единиц в байтах 0..i; байт с k-й единицей - число
+// байтов, где оно не больше k (сравнение всех байтов разом вычитанием).
+static int bb_select(Bitboard b, int k) {
+  uint64_t low = byte_counts(b.lo) * BYTE_ONES;
+  int in_low = (int)(low >> 56);
+  bool high = k >= in_low;
+  uint64_t bits = high ? b.hi : b.lo;
+  uint64_t prefix = high ? byte_counts(b.hi) * BYTE_ONES : low;
+  k -= high ? in_low : 0;
 
-  if (board[x][y] == 1) {
-    shots[x][y] = 1;
-    board[x][y] = 3; // Помечаем как попадание
-
-    // Проверяем, потоплен ли корабль
-    bool sunk = true;
-    // Проверяем все клетки вокруг
-    for (int dx = -1; dx <= 1; dx++) {
-      for (int dy = -1; dy <= 1; dy++) {
-        int nx = x + dx;
-        int ny = y + dy;
-        if (nx >= 0 && nx < BOARD_SIZE && ny >= 0 && ny < BOARD_SIZE) {
-          if (board[nx][ny] == 1) {
-            sunk = false;
-            break;
-          }
-        }
-      }
-      if (!sunk)
-        break;
-    }
+  uint64_t le = ((BYTE_ONES * (0x80 + (uint64_t)k)) - prefix) &
+                (BYTE_ONES * 0x80);
+  int byte = (int)(((le >> 7) * BYTE_ONES) >> 56);
+  int before = (int)(((prefix << 8) >> (8 * byte)) & 0xff);
+  int in_byte = byte_select[(bits >> (8 * byte)) & 0xff][k - before];
+  return (high ? 64 : 0) + 8 * byte + in_byte;
+}
 
-    // Более точная проверка: ищем все клетки корабля
-    if (sunk) {
-      // Проверяем горизонтальное направление
-      for (int i = x - 1; i >= 0 && board[i][y] != 0 && board[i][y] != 2; i--) {
-        if (board[i][y] == 1) {
-          sunk = false;
-          break;
-        }
-      }
-      for (int i = x + 1;
-           i < BOARD_SIZE && board[i][y] != 0 && board[i][y] != 2; i++) {
-        if (board[i][y] == 1) {
-          sunk = false;
-          break;
-        }
-      }
-      // Проверяем вертикальное направление
-      for (int j = y - 1; j >= 0 && board[x][j] != 0 && board[x][j] != 2; j--) {
-        if (board[x][j] == 1) {
-          sunk = false;
-          break;
+// Занятые клетки (корабли с ореолами) копятся по мере расстановки.
+// Позиция длины size недопустима, если хоть одна её клетка занята:
+// сдвиг занятых на i клеток назад даёт якоря, у которых занята i-я.
+void fleet_random(uint8_t fleet[MAX_SHIPS], uint32_t *rng) {
+  init_tables();
+  for (int attempt = 0; attempt < FLEET_RANDOM_ATTEMPTS; attempt++) {
+    Bitboard taken = {0, 0};
+    int i;
+    for (i = 0; i < MAX_SHIPS; i++) {
+      int size = fleet_sizes[i];
+      Bitboard legal[2];
+      int count[2];
+      for (int h = 0; h < 2; h++) {
+        int step = h ? 1 : BOARD_SIZE;
+        Bitboard blocked = taken;
+        for (int k = 1; k < size; k++) {
+          blocked = bb_or(blocked, bb_shr(taken, k * step));
         }
+        legal[h] = bb_andnot(anchors[h][size - 1], blocked);
+        // У однопалубного обе ориентации - одна позиция
+        count[h] = size > 1 || h == 0 ? bb_count(legal[h]) : 0;
       }
-      for (int j = y + 1;
-           j < BOARD_SIZE && board[x][j] != 0 && board[x][j] != 2; j++) {
-        if (board[x][j] == 1) {
-          sunk = false;
-          break;
-        }
+      uint32_t total = (uint32_t)(count[0] + count[1]);
+      if (total == 0) {
+        break;
       }
+      int k = (int)(((uint64_t)random_next(rng) * total) >> 32);
+      int h = k >= count[0];
+      int cell = bb_select(legal[h], h ? k - count[0] : k);
+      fleet[i] = fleet_pack(cell % BOARD_SIZE, cell / BOARD_SIZE, h);
+      taken = bb_or(taken, placements[h][size - 1][cell].halo);
+    }
+    if (i == MAX_SHIPS) {
+      return;
     }
+  }
+  memcpy(fleet, fallback_fleet, MAX_SHIPS);
+}
 
-    return sunk ? SHOT_SUNK : SHOT_HIT;
-  } else {
-    shots[x][y] = 2;
-    board[x][y] = 2; // Помечаем как промах
+uint8_t board_ship(const Board *board, int index, int *size) {
+  Bitboard b = board->ship_cells[index];
+  int cell = b.lo ? __builtin_ctzll(b.lo) : 64 + __builtin_ctzll(b.hi);
+  *size = bb_count(b);
+  int horizontal = *size > 1 && bb_test(b, cell + 1);
+  return fleet_pack(cell % BOARD_SIZE, cell / BOARD_SIZE, horizontal);
+}
+
+bool board_is_shot(const Board *board, int x, int y) {
+  return bb_test(bb_or(board->hits, board->misses), y * BOARD_SIZE + x);
+}
+
+ShotResult board_shot(Board *board, int x, int y) {
+  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE ||
+      board_is_shot(board, x, y)) {
+    return SHOT_INVALID;
+  }
+
+  // Владелец клетки и счётчик его целых клеток: без поиска по кораблям
+  int cell = y * BOARD_SIZE + x;
+  int ship = board->ship_at[cell];
+  if (ship == 0) {
+    board->misses = bb_or(board->misses, bb_cell(cell));
     return SHOT_MISS;
   }
+
+  board->hits = bb_or(board->hits, bb_cell(cell));
+  return --board->hits_left[ship - 1] == 0 ? SHOT_SUNK : SHOT_HIT;
 }
 
-// Проверка окончания игры
-bool check_game_over(int board[BOARD_SIZE][BOARD_SIZE]) {
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      if (board[i][j] == 1) {
-        return false; // Есть непотопленные корабли
-      }
+// Попадания бывают только по кораблям, так что достаточно сравнить маски
+bool board_all_sunk(const Board *board) {
+  return bb_equal(board->hits, board->ships);
+}
+
+// Маска клеток старой доски со значением a или b
+static Bitboard grid_mask(int board[BOARD_SIZE][BOARD_SIZE], int a, int b) {
+  Bitboard mask = {0, 0};
+  for (int cell = 0; cell < CELL_COUNT; cell++) {
+    int v = board[cell / BOARD_SIZE][cell % BOARD_SIZE];
+    if (v == a || v == b) {
+      mask = bb_or(mask, bb_cell(cell));
     }
   }
-  return true; // Все корабли потоплены
+  return mask;
+}
+
+// Инициализация доски
+void init_board(int board[BOARD_SIZE][BOARD_SIZE]) {
+  memset(board, 0, sizeof(int) * CELL_COUNT);
 }
 
-// Вывод доски
-void print_board(int board[BOARD_SIZE][BOARD_SIZE], bool show_ships) {
-  printf("   ");
-  for (int j = 0; j < BOARD_SIZE; j++) {
-    printf("%2d ", j);
+// Проверка валидности размещения корабля
+bool is_valid_placement(int board[BOARD_SIZE][BOARD_SIZE], int x, int y,
+                        int size, int horizontal) {
+  const Placement *p = find_placement(x, y, size, horizontal);
+  return p != NULL && bb_empty(bb_and(p->halo, grid_mask(board, 1, 3)));
+}
+
+// Размещение корабля
+bool place_ship(int board[BOARD_SIZE][BOARD_SIZE], int x, int y, int size,
+                int horizontal) {
+  if (!is_valid_placement(board, x, y, size, horizontal)) {
+    return false;
   }
-  printf("\n");
 
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    printf("%2d ", i);
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      if (board[i][j] == 0) {
-        printf(" . ");
-      } else if (board[i][j] == 1) {
-        if (show_ships) {
-          printf(" S ");
-        } else {
-          printf(" . ");
-        }
-      } else if (board[i][j] == 2) {
-        printf(" O ");
-      } else if (board[i][j] == 3) {
-        printf(" X ");
-      }
+  for (int i = 0; i < size; i++) {
+    if (horizontal == 1) {
+      board[y][x + i] = 1;
+    } else {
+      board[y + i][x] = 1;
     }
-    printf("\n");
   }
+  return true;
 }
 
-void print_boards_side_by_side(int my_board[BOARD_SIZE][BOARD_SIZE],
-                               int enemy_board[BOARD_SIZE][BOARD_SIZE]) {
-  // Заголовки
-  printf("      YOUR BOARD                     OPPONENT BOARD\n");
-
-  printf("   ");
-  for (int j = 0; j < BOARD_SIZE; j++) {
-    printf("%2d ", j);
+// Выстрел
+ShotResult make_shot(int board[BOARD_SIZE][BOARD_SIZE],
+                     int shots[BOARD_SIZE][BOARD_SIZE], int x, int y) {
+  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE ||
+      shots[y][x] != 0) {
+    return SHOT_INVALID;
   }
 
-  printf(" |   ");
-
-  for (int j = 0; j < BOARD_SIZE; j++) {
-    printf("%2d ", j);
+  if (board[y][x] != 1) {
+    shots[y][x] = 2;
+    board[y][x] = 2; // Помечаем как промах
+    return SHOT_MISS;
   }
-  printf("\n");
 
-  // Строки досок
-  for (int i = 0; i < BOARD_SIZE; i++) {
-    // Левая доска (твоя)
-    printf("%2d ", i);
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      if (my_board[i][j] == 0) {
-        printf(" . ");
-      } else if (my_board[i][j] == 1) {
-        printf(" S ");
-      } else if (my_board[i][j] == 2) {
-        printf(" O ");
-      } else if (my_board[i][j] == 3) {
-        printf(" X ");
-      }
-    }
-
-    // Разделитель
-    printf(" | ");
-
-    // Правая доска (противник)
-    printf("%2d ", i);
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      if (enemy_board[i][j] == 0 || enemy_board[i][j] == 1) {
-        printf(" . "); // корабли противника скрыты
-      } else if (enemy_board[i][j] == 2) {
-        printf(" O ");
-      } else if (enemy_board[i][j] == 3) {
-        printf(" X ");
-      }
-    }
+  shots[y][x] = 1;
+  board[y][x] = 3; // Помечаем как попадание
 
-    printf("\n");
+  // Корабль - связная область клеток кораблей вокруг выстрела:
+  // корабли не касаются друг друга, поэтому хватает расширения масок
+  init_tables();
+  Bitboard ships = grid_mask(board, 1, 3);
+  Bitboard ship = bb_cell(y * BOARD_SIZE + x);
+  for (int i = 1; i < MAX_SHIP_SIZE; i++) {
+    ship = bb_and(bb_dilate(ship), ships);
   }
+  return bb_empty(bb_andnot(ship, grid_mask(board, 3, 3))) ? SHOT_SUNK
+                                                           : SHOT_HIT;
+}
+
+// Проверка окончания игры
+bool check_game_over(int board[BOARD_SIZE][BOARD_SIZE]) {
+  return bb_empty(grid_mask(board, 1, 1));
 }
@@ -2,6 +2,7 @@
 #define COMMON_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,7 +13,9 @@
 #define MAX_PLAYERS 2
 #define BOARD_SIZE 10
 #define MAX_SHIPS 10
+// Начальная ёмкость реестра сервера, дальше он растёт сам
 #define MAX_GAMES 100
+#define MAX_SERVER_PLAYERS 100
 #define MAX_PLAYER_NAME 50
 #define MAX_GAME_NAME 50
 #define MAX_MESSAGE_SIZE 1024
@@ -32,7 +35,12 @@ typedef enum {
   MSG_ERROR,
   MSG_ACK,
   MSG_LIST_GAMES,
-  MSG_LIST_PLAYERS
+  MSG_LIST_PLAYERS,
+  MSG_LOGOUT,
+  MSG_PLACE_FLEET,
+  MSG_QUICK_MATCH,
+  MSG_PLAY_BOT, // партия против бота сервера (bot.h)
+  MSG_COUNT
 } MessageType;
 
 typedef enum {
@@ -44,6 +52,53 @@ typedef enum {
 
 typedef enum { SHOT_MISS = 0, SHOT_HIT, SHOT_SUNK, SHOT_INVALID } ShotResult;
 
+// Коды статусов в ответах сервера (текст - status_text() в protocol.c)
+typedef enum {
+  ST_NONE = 0,
+  ST_REGISTERED,
+  ST_ALREADY_REGISTERED,
+  ST_SERVER_FULL,
+  ST_NOT_REGISTERED,
+  ST_ALREADY_IN_GAME,
+  ST_GAME_EXISTS,
+  ST_CREATE_FAILED,
+  ST_GAME_CREATED,
+  ST_GAME_NOT_FOUND,
+  ST_GAME_FULL,
+  ST_JOIN_FAILED,
+  ST_JOINED,
+  ST_OPPONENT_JOINED,
+  ST_NOT_IN_GAME,
+  ST_PLAYER_NOT_FOUND,
+  ST_PLAYER_BUSY,
+  ST_INVITED,
+  ST_INVITE_SENT,
+  ST_CANNOT_PLACE,
+  ST_SHIP_PLACED,
+  ST_INVALID_PLACEMENT,
+  ST_YOUR_TURN,
+  ST_OPPONENT_TURN,
+  ST_OPPONENT_PREPARING,
+  ST_CANNOT_SHOOT,
+  ST_NOT_YOUR_TURN,
+  ST_INVALID_COORDS,
+  ST_ALREADY_SHOT,
+  ST_OPPONENT_SHOT,
+  ST_YOU_WON,
+  ST_YOU_LOST,
+  ST_NO_GAMES,
+  ST_FLEET_PLACED,
+  ST_INVALID_FLEET, // x - номер первого неверного корабля
+  ST_MATCH_QUEUED,
+  ST_MATCH_FOUND,
+  ST_MATCH_TIMEOUT,      // очередь быстрой игры: соперник не нашёлся
+  ST_GAME_ABANDONED,     // партия снята по тайм-ауту без победителя
+  ST_TIMED_OUT,          // игрок не уложился в срок и проиграл
+  ST_OPPONENT_TIMED_OUT, // соперник не уложился в срок
+  ST_SERVER_BUSY,        // очередь потока сервера полна, запрос не принят
+  ST_COUNT
+} StatusCode;
+
 typedef struct {
   MessageType type;
   char sender[MAX_PLAYER_NAME];
@@ -52,36 +107,129 @@ typedef struct {
   char data[MAX_MESSAGE_SIZE];
   int x, y;
   ShotResult shot_result;
-  int game_id;
+  int64_t game_id;
+  StatusCode status;
+  uint8_t fleet[MAX_SHIPS]; // MSG_PLACE_FLEET: корабли по порядку fleet_sizes
+  uint64_t session;         // дескриптор сессии из ответа на MSG_REGISTER
 } Message;
 
+// Битовая доска: бит y * BOARD_SIZE + x, клетки 0..63 в lo, 64..99 в hi
 typedef struct {
-  char login[MAX_PLAYER_NAME];
-  char identity[256];
-  void *socket;
-  int game_id;
+  uint64_t lo, hi;
+} Bitboard;
+
+#define BYTE_ONES 0x0101010101010101ull
+
+// Число единиц в каждом байте слова. Сборка не требует -mpopcnt, а без
+// него __builtin_popcountll - вызов функции libgcc; подсчёт нужен
+// десятки раз на расстановку и на каждый ход бота.
+static inline uint64_t byte_counts(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  return (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+}
+
+static inline int bit_count(uint64_t x) {
+  return (int)((byte_counts(x) * BYTE_ONES) >> 56);
+}
+
+static inline int bb_count(Bitboard b) {
+  uint64_t counts = byte_counts(b.lo) + byte_counts(b.hi);
+  return (int)((counts * BYTE_ONES) >> 56);
+}
+
+// Поле игрока в виде битовых масок
+typedef struct {
+  Bitboard ships;                 // клетки кораблей
+  Bitboard hits;                  // попадания соперника
+  Bitboard misses;                // промахи соперника
+  Bitboard ship_cells[MAX_SHIPS]; // клетки каждого корабля
+  int ship_count;
+  uint8_t ship_at[BOARD_SIZE * BOARD_SIZE]; // номер корабля + 1, 0 - вода
+  uint8_t hits_left[MAX_SHIPS]; // сколько клеток корабля ещё не подбито
+} Board;
+
+// Поля, которые нужны на каждое сообщение, стоят в начале записи: поиск
+// по дескриптору и соперник по партии читают одну строку кэша записи
+typedef struct {
+  int64_t id; // Слот в реестре + поколение
+  int64_t game_id;
+  uint64_t session;   // У воркера: id игрока в лобби, им подписаны запросы
+  uint32_t slot;
+  uint32_t last_seen; // У лобби: тик последнего запроса игрока
   bool in_game;
   bool ready;
+  bool bot; // У воркера: встроенный соперник (bot.h)
+  size_t identity_len;
+  void *socket;
+  char login[MAX_PLAYER_NAME];
+  char identity[256];
 } Player;
 
 typedef struct {
-  int id;
-  char name[MAX_GAME_NAME];
-  char players[MAX_PLAYERS][MAX_PLAYER_NAME];
+  int64_t id;
+  uint32_t slot; // Слот в реестре этого потока
   int player_count;
+  Player *player_refs[MAX_PLAYERS]; // Записи игроков на сервере
   GameStatus status;
   int current_turn; // Индекс игрока, чей ход
-  int boards[MAX_PLAYERS][BOARD_SIZE]
-            [BOARD_SIZE]; // 0 - пусто, 1 - корабль, 2 - промах, 3 - попадание
-  int shots[MAX_PLAYERS][BOARD_SIZE][BOARD_SIZE]; // История выстрелов
-  int ships_remaining[MAX_PLAYERS]; // Количество оставшихся кораблей
+  char name[MAX_GAME_NAME];
+  char players[MAX_PLAYERS][MAX_PLAYER_NAME];
+  Board boards[MAX_PLAYERS]; // Корабли игрока и выстрелы соперника по ним
+  // Корабли на плаву; MAX_SHIPS, когда флот расставлен целиком, партия
+  // кончается на нуле
+  int ships_remaining[MAX_PLAYERS];
+  uint32_t list_seq;   // Номер в списке открытых игр лобби, 0 - не в списке
+  uint32_t turn_limit; // Секунд на ход
+  uint32_t deadline;   // У воркера: тик конца хода или расстановки
+  struct GameLog *log; // У воркера: ходы партии для архива (archive.h)
 } Game;
 
-// int send_message(void *socket, Message *msg);
+int send_message(void *socket, Message *msg);
 int receive_message(void *socket, Message *msg);
 int receive_message_nonblock(void *socket, Message *msg);
 void print_message(Message *msg);
 
+// Состав флота: размеры кораблей в порядке их описания в MSG_PLACE_FLEET
+extern const int fleet_sizes[MAX_SHIPS];
+
+// Корабль флота в одном байте: клетка y * BOARD_SIZE + x и бит ориентации
+#define FLEET_HORIZONTAL 0x80
+static inline uint8_t fleet_pack(int x, int y, int horizontal) {
+  return (uint8_t)((y * BOARD_SIZE + x) |
+                   (horizontal == 1 ? FLEET_HORIZONTAL : 0));
+}
+
+void board_clear(Board *board);
+bool board_can_place(const Board *board, int x, int y, int size,
+                     int horizontal);
+bool board_place_ship(Board *board, int x, int y, int size, int horizontal);
+// Весь флот или ничего; при ошибке *bad_ship - номер первого неверного корабля
+bool board_place_fleet(Board *board, const uint8_t fleet[MAX_SHIPS],
+                       int *bad_ship);
+// Корабль поля с номером index в формате флота, *size - его длина
+uint8_t board_ship(const Board *board, int index, int *size);
+
+// Генератор xorshift32 расстановок и ботов. Состояние - любое ненулевое
+// число; одно и то же зерно даёт ту же последовательность.
+static inline uint32_t random_next(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// Случайный флот в формате MSG_PLACE_FLEET. Каждый корабль ставится в
+// позицию, равновероятно выбранную из допустимых при уже поставленных;
+// время ограничено, флот всегда допустимый.
+void fleet_random(uint8_t fleet[MAX_SHIPS], uint32_t *rng);
+bool board_is_shot(const Board *board, int x, int y);
+ShotResult board_shot(Board *board, int x, int y);
+bool board_all_sunk(const Board *board);
+
+// Старый интерфейс поверх битовых досок.
+// Клетка board[y][x]: 0 - пусто, 1 - корабль, 2 - промах, 3 - попадание
 void init_board(int board[BOARD_SIZE][BOARD_SIZE]);
 bool place_ship(int board[BOARD_SIZE][BOARD_SIZE], int x, int y, int size,
                 int horizontal);
@@ -90,8 +238,5 @@ bool is_valid_placement(int board[BOARD_SIZE][BOARD_SIZE], int x, int y,
 ShotResult make_shot(int board[BOARD_SIZE][BOARD_SIZE],
                      int shots[BOARD_SIZE][BOARD_SIZE], int x, int y);
 bool check_game_over(int board[BOARD_SIZE][BOARD_SIZE]);
-void print_board(int board[BOARD_SIZE][BOARD_SIZE], bool show_ships);
-void print_boards_side_by_side(int my_board[BOARD_SIZE][BOARD_SIZE],
-                               int enemy_board[BOARD_SIZE][BOARD_SIZE]);
 
 #endif // COMMON_H
@@ -0,0 +1,900 @@
+#include "journal.h"
+#include "log.h"
+#include "stats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_MAGIC 0x4e534253u // "SBSN"
+#define SNAPSHOT_VERSION 4
+#define RECORD_PAYLOAD_MAX 255
+#define JOURNAL_PATH_SIZE 512
+
+// Запись журнала: [длина тела:1][тип:1][тело][контрольная сумма:4]
+typedef enum {
+  REC_REGISTER = 1, // id игрока, логин
+  REC_LOGOUT,       // логин
+  REC_CREATE,       // id, логин создателя, имя игры
+  REC_JOIN,         // id, логин
+  REC_PLACE_SHIP,   // id, игрок, клетка и ориентация, размер
+  REC_PLACE_FLEET,  // id, игрок, флот
+  REC_SHOT,         // id, стреляющий игрок, клетка
+  REC_FINISH        // id
+} RecordType;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq; // первый журнал после снимка
+  uint32_t player_count;
+  uint32_t game_count;
+  // Старшие поколения выданных id, в том числе уже освобождённых
+  uint32_t player_generation;
+  uint32_t game_generation;
+} SnapshotHeader;
+
+// id игрока сохраняется: это дескриптор сессии клиента
+typedef struct {
+  int64_t id;
+  char login[MAX_PLAYER_NAME];
+} SnapshotPlayer;
+
+// Отдельные корабли восстанавливаются по клеткам: корабли не касаются
+typedef struct {
+  Bitboard ships;
+  Bitboard hits;
+  Bitboard misses;
+} SnapshotBoard;
+
+typedef struct {
+  int64_t id;
+  uint8_t status;
+  uint8_t current_turn;
+  uint8_t player_count;
+  uint8_t ships_remaining[MAX_PLAYERS];
+  char name[MAX_GAME_NAME];
+  char players[MAX_PLAYERS][MAX_PLAYER_NAME];
+  SnapshotBoard boards[MAX_PLAYERS];
+} SnapshotGame;
+
+typedef struct {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+} Buffer;
+
+static struct {
+  bool enabled;
+  char dir[JOURNAL_PATH_SIZE];
+  int fd;
+  uint32_t seq;
+  size_t written; // байт в текущем журнале
+  Registry *state;
+  // Старшие поколения id игроков и игр из записей и снимка: после
+  // перезапуска лобби выдаёт id только выше них
+  uint32_t player_generation;
+  uint32_t game_generation;
+
+  pthread_mutex_t lock;
+  Buffer pending; // записи, ещё не отданные потоку журнала
+  bool stopping;  // под lock
+  bool started;
+  pthread_t thread;
+} journal = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+// FNV-1a
+static uint32_t checksum(const uint8_t *data, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static bool buffer_put(Buffer *b, const uint8_t *data, size_t len) {
+  if (b->len + len > b->cap) {
+    size_t cap = b->cap ? b->cap * 2 : 4096;
+    while (cap < b->len + len) {
+      cap *= 2;
+    }
+    uint8_t *grown = realloc(b->data, cap);
+    if (grown == NULL) {
+      return false;
+    }
+    b->data = grown;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  return true;
+}
+
+// Сборка записи
+
+typedef struct {
+  uint8_t buf[RECORD_PAYLOAD_MAX + 6];
+  size_t len;
+} Record;
+
+static void record_begin(Record *r, RecordType type) {
+  r->buf[1] = (uint8_t)type;
+  r->len = 2;
+}
+
+static void put_u8(Record *r, int value) { r->buf[r->len++] = (uint8_t)value; }
+
+static void put_i64(Record *r, int64_t value) {
+  uint64_t v = (uint64_t)value;
+  for (int i = 0; i < 8; i++) {
+    r->buf[r->len++] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static void put_str(Record *r, const char *s, size_t cap) {
+  size_t len = strnlen(s, cap - 1);
+  put_u8(r, (int)len);
+  memcpy(r->buf + r->len, s, len);
+  r->len += len;
+}
+
+static void put_bytes(Record *r, const uint8_t *data, size_t len) {
+  memcpy(r->buf + r->len, data, len);
+  r->len += len;
+}
+
+static void record_append(Record *r) {
+  if (!journal.enabled) {
+    return;
+  }
+  r->buf[0] = (uint8_t)(r->len - 2);
+  uint32_t sum = checksum(r->buf + 1, r->len - 1);
+  for (int i = 0; i < 4; i++) {
+    r->buf[r->len++] = (uint8_t)(sum >> (8 * i));
+  }
+
+  pthread_mutex_lock(&journal.lock);
+  bool ok = buffer_put(&journal.pending, r->buf, r->len);
+  pthread_mutex_unlock(&journal.lock);
+  if (!ok) {
+    log_error("Journal: out of memory, record dropped");
+  }
+}
+
+void journal_register(int64_t player_id, const char *login) {
+  Record r;
+  record_begin(&r, REC_REGISTER);
+  put_i64(&r, player_id);
+  put_str(&r, login, MAX_PLAYER_NAME);
+  record_append(&r);
+}
+
+void journal_logout(const char *login) {
+  Record r;
+  record_begin(&r, REC_LOGOUT);
+  put_str(&r, login, MAX_PLAYER_NAME);
+  record_append(&r);
+}
+
+void journal_create(int64_t game_id, const char *login, const char *name) {
+  Record r;
+  record_begin(&r, REC_CREATE);
+  put_i64(&r, game_id);
+  put_str(&r, login, MAX_PLAYER_NAME);
+  put_str(&r, name, MAX_GAME_NAME);
+  record_append(&r);
+}
+
+void journal_join(int64_t game_id, const char *login) {
+  Record r;
+  record_begin(&r, REC_JOIN);
+  put_i64(&r, game_id);
+  put_str(&r, login, MAX_PLAYER_NAME);
+  record_append(&r);
+}
+
+void journal_place_ship(int64_t game_id, int player, int x, int y, int size,
+                        int horizontal) {
+  Record r;
+  record_begin(&r, REC_PLACE_SHIP);
+  put_i64(&r, game_id);
+  put_u8(&r, player);
+  put_u8(&r, fleet_pack(x, y, horizontal));
+  put_u8(&r, size);
+  record_append(&r);
+}
+
+void journal_place_fleet(int64_t game_id, int player,
+                         const uint8_t fleet[MAX_SHIPS]) {
+  Record r;
+  record_begin(&r, REC_PLACE_FLEET);
+  put_i64(&r, game_id);
+  put_u8(&r, player);
+  put_bytes(&r, fleet, MAX_SHIPS);
+  record_append(&r);
+}
+
+void journal_shot(int64_t game_id, int player, int x, int y) {
+  Record r;
+  record_begin(&r, REC_SHOT);
+  put_i64(&r, game_id);
+  put_u8(&r, player);
+  put_u8(&r, y * BOARD_SIZE + x);
+  record_append(&r);
+}
+
+void journal_finish(int64_t game_id) {
+  Record r;
+  record_begin(&r, REC_FINISH);
+  put_i64(&r, game_id);
+  record_append(&r);
+}
+
+// Разбор записи
+
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  size_t pos;
+  bool ok;
+} Reader;
+
+static int get_u8(Reader *r) {
+  if (r->pos >= r->len) {
+    r->ok = false;
+    return 0;
+  }
+  return r->data[r->pos++];
+}
+
+static int64_t get_i64(Reader *r) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) {
+    v |= (uint64_t)get_u8(r) << (8 * i);
+  }
+  return (int64_t)v;
+}
+
+static void get_str(Reader *r, char *out, size_t cap) {
+  size_t len = (size_t)get_u8(r);
+  if (len >= cap || r->pos + len > r->len) {
+    r->ok = false;
+    out[0] = '\0';
+    return;
+  }
+  memcpy(out, r->data + r->pos, len);
+  out[len] = '\0';
+  r->pos += len;
+}
+
+// Применение к состоянию: те же правила, что у лобби и воркеров
+
+static Game *find_game(Registry *state, Reader *r, int *player) {
+  Game *game = registry_find_game_by_id(state, get_i64(r));
+  if (player != NULL) {
+    *player = get_u8(r);
+    if (game != NULL && *player >= game->player_count) {
+      return NULL;
+    }
+  }
+  return r->ok ? game : NULL;
+}
+
+static void mark_ready(Game *game, int player) {
+  game->player_refs[player]->ready = true;
+  if (game->player_count < MAX_PLAYERS) {
+    return;
+  }
+  for (int i = 0; i < game->player_count; i++) {
+    if (!game->player_refs[i]->ready) {
+      return;
+    }
+  }
+  game->status = GAME_PLAYING;
+  game->current_turn = 0;
+}
+
+static void apply_shot(Game *game, int player, int cell) {
+  if (game->status != GAME_PLAYING || cell < 0 ||
+      cell >= BOARD_SIZE * BOARD_SIZE) {
+    return;
+  }
+  int opponent = 1 - player;
+  ShotResult result = board_shot(&game->boards[opponent], cell % BOARD_SIZE,
+                                 cell / BOARD_SIZE);
+  if (result == SHOT_MISS) {
+    game->current_turn = opponent;
+  } else if (result == SHOT_SUNK) {
+    game->ships_remaining[opponent]--;
+  }
+}
+
+static void note_id(uint32_t *generation, int64_t id) {
+  if (id > 0 && POOL_GENERATION(id) > *generation) {
+    *generation = POOL_GENERATION(id);
+  }
+}
+
+static bool apply(Registry *state, int type, Reader *r) {
+  char login[MAX_PLAYER_NAME];
+  char name[MAX_GAME_NAME];
+  Player *player;
+  Game *game;
+  int index;
+
+  switch (type) {
+  case REC_REGISTER: {
+    // Игроки копии занимают те же слоты, что и в лобби
+    int64_t id = get_i64(r);
+    get_str(r, login, sizeof(login));
+    if (r->ok) {
+      note_id(&journal.player_generation, id);
+    }
+    if (r->ok && registry_find_player(state, login) == NULL) {
+      registry_restore_player(state, id, login, login);
+    }
+    break;
+  }
+  case REC_LOGOUT:
+    get_str(r, login, sizeof(login));
+    player = r->ok ? registry_find_player(state, login) : NULL;
+    if (player != NULL && !player->in_game) {
+      registry_remove_player(state, player);
+    }
+    break;
+  case REC_CREATE: {
+    int64_t id = get_i64(r);
+    get_str(r, login, sizeof(login));
+    get_str(r, name, sizeof(name));
+    if (r->ok) {
+      note_id(&journal.game_generation, id);
+    }
+    player = r->ok ? registry_find_player(state, login) : NULL;
+    if (player != NULL && !player->in_game) {
+      registry_create_game_with_id(state, id, name, player);
+    }
+    break;
+  }
+  case REC_JOIN:
+    game = find_game(state, r, NULL);
+    get_str(r, login, sizeof(login));
+    player = r->ok ? registry_find_player(state, login) : NULL;
+    if (game != NULL && player != NULL && !player->in_game) {
+      registry_join_game(state, game, player);
+    }
+    break;
+  case REC_PLACE_SHIP: {
+    game = find_game(state, r, &index);
+    uint8_t ship = (uint8_t)get_u8(r);
+    int size = get_u8(r);
+    int cell = ship & ~FLEET_HORIZONTAL;
+    if (game != NULL && r->ok &&
+        board_place_ship(&game->boards[index], cell % BOARD_SIZE,
+                         cell / BOARD_SIZE, size,
+                         (ship & FLEET_HORIZONTAL) ? 1 : 0) &&
+        game->boards[index].ship_count == MAX_SHIPS) {
+      game->ships_remaining[index] = MAX_SHIPS;
+      mark_ready(game, index);
+    }
+    break;
+  }
+  case REC_PLACE_FLEET: {
+    game = find_game(state, r, &index);
+    uint8_t fleet[MAX_SHIPS];
+    for (int i = 0; i < MAX_SHIPS; i++) {
+      fleet[i] = (uint8_t)get_u8(r);
+    }
+    int bad_ship;
+    if (game != NULL && r->ok &&
+        board_place_fleet(&game->boards[index], fleet, &bad_ship)) {
+      game->ships_remaining[index] = MAX_SHIPS;
+      mark_ready(game, index);
+    }
+    break;
+  }
+  case REC_SHOT: {
+    game = find_game(state, r, &index);
+    int cell = get_u8(r);
+    if (game != NULL && r->ok) {
+      apply_shot(game, index, cell);
+    }
+    break;
+  }
+  case REC_FINISH:
+    game = find_game(state, r, NULL);
+    if (game != NULL) {
+      registry_finish_game(state, game);
+    }
+    break;
+  default:
+    return false;
+  }
+  return r->ok;
+}
+
+// Применяет записи из буфера; возвращает длину целой части, оборванный
+// хвост или повреждённая запись останавливают разбор
+static size_t apply_records(Registry *state, const uint8_t *data, size_t len,
+                            size_t *count) {
+  size_t pos = 0;
+  while (pos + 6 <= len) {
+    size_t body = data[pos];
+    size_t total = body + 6;
+    if (pos + total > len) {
+      break;
+    }
+    const uint8_t *sum = data + pos + 2 + body;
+    uint32_t expected = (uint32_t)sum[0] | (uint32_t)sum[1] << 8 |
+                        (uint32_t)sum[2] << 16 | (uint32_t)sum[3] << 24;
+    if (checksum(data + pos + 1, body + 1) != expected) {
+      break;
+    }
+
+    Reader r = {data + pos + 2, body, 0, true};
+    apply(state, data[pos + 1], &r);
+    (*count)++;
+    pos += total;
+  }
+  return pos;
+}
+
+// Файлы
+
+static void journal_path(char *path, size_t size, uint32_t seq) {
+  snprintf(path, size, "%s/journal-%08u.bin", journal.dir, seq);
+}
+
+static void sync_dir(void) {
+  int fd = open(journal.dir, O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+// Журнал с номером seq; -1, если его нет
+static long replay(Registry *state, uint32_t seq) {
+  char path[JOURNAL_PATH_SIZE + 32];
+  journal_path(path, sizeof(path), seq);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  size_t count = 0;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      size_t used = apply_records(state, data, (size_t)st.st_size, &count);
+      if (used < (size_t)st.st_size) {
+        fprintf(stderr, "Journal: %s: dropped %zu bytes of damaged tail\n",
+                path, (size_t)st.st_size - used);
+      }
+      munmap(data, (size_t)st.st_size);
+    }
+  }
+  close(fd);
+  return (long)count;
+}
+
+// Корабли снимка не касаются друг друга, поэтому каждый восстанавливается
+// от своей левой верхней клетки вправо или вниз
+static bool cell_is_set(Bitboard b, int cell) {
+  return cell < 64 ? (b.lo >> cell) & 1 : (b.hi >> (cell - 64)) & 1;
+}
+
+static void set_cell(Bitboard *b, int cell) {
+  if (cell < 64) {
+    b->lo |= 1ull << cell;
+  } else {
+    b->hi |= 1ull << (cell - 64);
+  }
+}
+
+static void restore_board(Board *board, const SnapshotBoard *saved) {
+  board_clear(board);
+  for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; cell++) {
+    if (!cell_is_set(saved->ships, cell) || cell_is_set(board->ships, cell) ||
+        board->ship_count == MAX_SHIPS)
+      continue;
+
+    int x = cell % BOARD_SIZE;
+    bool horizontal =
+        x + 1 < BOARD_SIZE && cell_is_set(saved->ships, cell + 1);
+    int step = horizontal ? 1 : BOARD_SIZE;
+    int end = horizontal ? cell - x + BOARD_SIZE : BOARD_SIZE * BOARD_SIZE;
+
+    int index = board->ship_count++;
+    Bitboard *ship = &board->ship_cells[index];
+    for (int c = cell; c < end && cell_is_set(saved->ships, c); c += step) {
+      set_cell(ship, c);
+      set_cell(&board->ships, c);
+      board->ship_at[c] = (uint8_t)(index + 1);
+      if (!cell_is_set(saved->hits, c)) {
+        board->hits_left[index]++;
+      }
+    }
+  }
+  board->hits = saved->hits;
+  board->misses = saved->misses;
+}
+
+static bool snapshot_write(Registry *state, uint32_t seq) {
+  char path[JOURNAL_PATH_SIZE + 32], tmp[JOURNAL_PATH_SIZE + 32];
+  snprintf(path, sizeof(path), "%s/snapshot.bin", journal.dir);
+  snprintf(tmp, sizeof(tmp), "%s/snapshot.tmp", journal.dir);
+
+  size_t players = state->players.count, games = state->games.count;
+  size_t size = sizeof(SnapshotHeader) + players * sizeof(SnapshotPlayer) +
+                games * sizeof(SnapshotGame);
+
+  int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+    fprintf(stderr, "Journal: cannot create %s: %s\n", tmp, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Journal: cannot map %s: %s\n", tmp, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  SnapshotHeader *header = (SnapshotHeader *)map;
+  *header = (SnapshotHeader){SNAPSHOT_MAGIC, SNAPSHOT_VERSION, seq,
+                             (uint32_t)players, (uint32_t)games,
+                             journal.player_generation,
+                             journal.game_generation};
+
+  SnapshotPlayer *sp = (SnapshotPlayer *)(header + 1);
+  size_t cursor = 0;
+  Player *p;
+  while ((p = registry_next_player(state, &cursor)) != NULL) {
+    sp->id = p->id;
+    memcpy(sp->login, p->login, MAX_PLAYER_NAME);
+    sp++;
+  }
+
+  SnapshotGame *sg = (SnapshotGame *)sp;
+  cursor = 0;
+  Game *g;
+  while ((g = registry_next_game(state, &cursor)) != NULL) {
+    sg->id = g->id;
+    sg->status = (uint8_t)g->status;
+    sg->current_turn = (uint8_t)g->current_turn;
+    sg->player_count = (uint8_t)g->player_count;
+    memcpy(sg->name, g->name, MAX_GAME_NAME);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+      sg->ships_remaining[i] = (uint8_t)g->ships_remaining[i];
+      memcpy(sg->players[i], g->players[i], MAX_PLAYER_NAME);
+      sg->boards[i] = (SnapshotBoard){g->boards[i].ships, g->boards[i].hits,
+                                      g->boards[i].misses};
+    }
+    sg++;
+  }
+
+  bool ok = msync(map, size, MS_SYNC) == 0;
+  munmap(map, size);
+  close(fd);
+  if (!ok || rename(tmp, path) != 0) {
+    fprintf(stderr, "Journal: cannot write snapshot: %s\n", strerror(errno));
+    return false;
+  }
+  sync_dir();
+  return true;
+}
+
+static bool snapshot_load_game(Registry *state, const SnapshotGame *sg) {
+  Player *players[MAX_PLAYERS] = {0};
+  for (int i = 0; i < sg->player_count && i < MAX_PLAYERS; i++) {
+    players[i] = registry_find_player(state, sg->players[i]);
+    if (players[i] == NULL) {
+      return false;
+    }
+  }
+
+  Game *game = players[0] ? registry_create_game_with_id(state, sg->id,
+                                                         sg->name, players[0])
+                          : NULL;
+  if (game == NULL ||
+      (players[1] && !registry_join_game(state, game, players[1]))) {
+    return false;
+  }
+
+  game->status = (GameStatus)sg->status;
+  game->current_turn = sg->current_turn;
+  for (int i = 0; i < game->player_count; i++) {
+    game->ships_remaining[i] = sg->ships_remaining[i];
+    restore_board(&game->boards[i], &sg->boards[i]);
+    players[i]->ready = game->boards[i].ship_count == MAX_SHIPS;
+  }
+  return true;
+}
+
+// Нет снимка - пустое состояние и *seq = 0
+static bool snapshot_load(Registry *state, uint32_t *seq) {
+  char path[JOURNAL_PATH_SIZE + 32];
+  snprintf(path, sizeof(path), "%s/snapshot.bin", journal.dir);
+  *seq = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return errno == ENOENT;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const SnapshotHeader *header = (const SnapshotHeader *)map;
+  bool ok = header->magic == SNAPSHOT_MAGIC &&
+            header->version == SNAPSHOT_VERSION &&
+            size == sizeof(SnapshotHeader) +
+                        header->player_count * sizeof(SnapshotPlayer) +
+                        header->game_count * sizeof(SnapshotGame);
+
+  ok = ok && registry_reserve(state, header->player_count, header->game_count);
+
+  if (ok) {
+    journal.player_generation = header->player_generation;
+    journal.game_generation = header->game_generation;
+  }
+
+  const SnapshotPlayer *sp = (const SnapshotPlayer *)(header + 1);
+  for (uint32_t i = 0; ok && i < header->player_count; i++) {
+    ok = registry_restore_player(state, sp[i].id, sp[i].login, sp[i].login) !=
+         NULL;
+  }
+  const SnapshotGame *sg =
+      (const SnapshotGame *)(sp + (ok ? header->player_count : 0));
+  for (uint32_t i = 0; ok && i < header->game_count; i++) {
+    ok = snapshot_load_game(state, &sg[i]);
+  }
+
+  if (ok) {
+    *seq = header->seq;
+  }
+  munmap((void *)map, size);
+  return ok;
+}
+
+// Новый журнал и снимок состояния на момент его начала
+static bool checkpoint(void) {
+  uint32_t seq = journal.seq + 1;
+  char path[JOURNAL_PATH_SIZE + 32];
+  journal_path(path, sizeof(path), seq);
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Journal: cannot create %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  if (!snapshot_write(journal.state, seq)) {
+    close(fd);
+    unlink(path);
+    return false;
+  }
+
+  // Снимок уже покрывает старый журнал
+  if (journal.fd >= 0) {
+    close(journal.fd);
+  }
+  journal_path(path, sizeof(path), journal.seq);
+  unlink(path);
+
+  journal.fd = fd;
+  journal.seq = seq;
+  journal.written = 0;
+  return true;
+}
+
+bool journal_open(const char *dir, Registry *state) {
+  snprintf(journal.dir, sizeof(journal.dir), "%s", dir);
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Journal: cannot create %s: %s\n", dir, strerror(errno));
+    return false;
+  }
+
+  uint64_t started = stats_now_ns();
+  uint32_t first;
+  if (!snapshot_load(state, &first)) {
+    fprintf(stderr, "Journal: damaged snapshot in %s\n", dir);
+    return false;
+  }
+
+  size_t records = 0;
+  uint32_t last = first;
+  long count;
+  for (uint32_t seq = first; (count = replay(state, seq)) >= 0; seq++) {
+    records += (size_t)count;
+    last = seq;
+  }
+
+  journal.state = state;
+  journal.seq = last;
+  if (!checkpoint()) {
+    return false;
+  }
+  // Журналы до снимка, в том числе оставшиеся после сбоя
+  for (uint32_t seq = first ? first - 1 : 0; seq < last; seq++) {
+    char path[JOURNAL_PATH_SIZE + 32];
+    journal_path(path, sizeof(path), seq);
+    unlink(path);
+  }
+
+  journal.enabled = true;
+  printf("Restored %zu players and %zu games (%zu journal records) in "
+         "%.1f ms\n",
+         state->players.count, state->games.count, records,
+         (stats_now_ns() - started) / 1e6);
+  return true;
+}
+
+// Игроки лобби ищутся по id: у них те же слоты, что и в состоянии
+static bool restore_lobby_game(Registry *lobby, const Game *src) {
+  Player *creator = registry_find_player_by_id(lobby, src->player_refs[0]->id);
+  Game *game =
+      creator ? registry_restore_game(lobby, src->id, src->name, creator)
+              : NULL;
+  if (game == NULL) {
+    return false;
+  }
+  if (src->player_count > 1) {
+    Player *p = registry_find_player_by_id(lobby, src->player_refs[1]->id);
+    if (p == NULL || !registry_join_game(lobby, game, p)) {
+      return false;
+    }
+  }
+  game->status = src->status;
+  game->current_turn = src->current_turn;
+  return true;
+}
+
+// Воркер держит свои копии игроков, как после handle_setup_game
+static bool restore_worker_game(Registry *worker, const Game *src) {
+  Player *players[MAX_PLAYERS] = {0};
+  for (int i = 0; i < src->player_count; i++) {
+    players[i] = registry_add_player(worker, src->players[i], src->players[i]);
+    if (players[i] == NULL) {
+      return false;
+    }
+    players[i]->ready = src->player_refs[i]->ready;
+    players[i]->session = (uint64_t)src->player_refs[i]->id;
+  }
+
+  Game *game =
+      registry_create_game_with_id(worker, src->id, src->name, players[0]);
+  if (game == NULL ||
+      (players[1] && !registry_join_game(worker, game, players[1]))) {
+    return false;
+  }
+  game->status = src->status;
+  game->current_turn = src->current_turn;
+  memcpy(game->boards, src->boards, sizeof(game->boards));
+  memcpy(game->ships_remaining, src->ships_remaining,
+         sizeof(game->ships_remaining));
+  return true;
+}
+
+bool journal_restore(Registry *state, Registry *lobby, Registry *workers[],
+                     int worker_count) {
+  // Реестры сразу нужного размера: без перестроек хэш-индексов
+  size_t *games = calloc((size_t)worker_count, sizeof(size_t));
+  if (games == NULL) {
+    return false;
+  }
+  size_t cursor = 0;
+  Game *g;
+  while ((g = registry_next_game(state, &cursor)) != NULL) {
+    games[(uint64_t)g->id % (uint64_t)worker_count]++;
+  }
+  bool ok = registry_reserve(lobby, state->players.count, state->games.count);
+  for (int i = 0; ok && i < worker_count; i++) {
+    ok = registry_reserve(workers[i], games[i] * MAX_PLAYERS, games[i]);
+  }
+  free(games);
+
+  cursor = 0;
+  Player *p;
+  while (ok && (p = registry_next_player(state, &cursor)) != NULL) {
+    ok = registry_restore_player(lobby, p->id, p->login, p->login) != NULL;
+  }
+
+  cursor = 0;
+  while (ok && (g = registry_next_game(state, &cursor)) != NULL) {
+    Registry *worker = workers[(uint64_t)g->id % (uint64_t)worker_count];
+    ok = restore_lobby_game(lobby, g) && restore_worker_game(worker, g);
+  }
+
+  registry_restore_done(lobby, journal.player_generation,
+                        journal.game_generation);
+  return ok;
+}
+
+// Групповая фиксация: всё накопленное за JOURNAL_FLUSH_MS - одним
+// write и одним fdatasync
+static void *journal_main(void *arg) {
+  (void)arg;
+  Buffer batch = {0};
+  bool failed = false;
+  bool stop = false;
+
+  while (!stop) {
+    usleep(JOURNAL_FLUSH_MS * 1000);
+
+    pthread_mutex_lock(&journal.lock);
+    stop = journal.stopping;
+    Buffer swap = journal.pending;
+    journal.pending = batch;
+    batch = swap;
+    pthread_mutex_unlock(&journal.lock);
+
+    if (batch.len == 0)
+      continue;
+
+    if (!write_all(journal.fd, batch.data, batch.len) ||
+        fdatasync(journal.fd) != 0) {
+      if (!failed) {
+        log_error("Journal: write failed: %s", strerror(errno));
+      }
+      failed = true;
+    }
+
+    size_t count = 0;
+    apply_records(journal.state, batch.data, batch.len, &count);
+    journal.written += batch.len;
+    batch.len = 0;
+
+    if (journal.written >= JOURNAL_SNAPSHOT_BYTES) {
+      checkpoint();
+    }
+  }
+
+  return NULL;
+}
+
+bool journal_start(void) {
+  if (!journal.enabled ||
+      pthread_create(&journal.thread, NULL, journal_main, NULL) != 0) {
+    return false;
+  }
+  journal.started = true;
+  return true;
+}
+
+void journal_stop(void) {
+  if (!journal.started) {
+    return;
+  }
+  pthread_mutex_lock(&journal.lock);
+  journal.stopping = true;
+  pthread_mutex_unlock(&journal.lock);
+  pthread_join(journal.thread, NULL);
+  journal.started = false;
+}
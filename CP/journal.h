@@ -0,0 +1,50 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "registry.h"
+
+// Журнал изменений состояния сервера и снимок для быстрого перезапуска.
+//
+// Потоки сервера добавляют записи в общий буфер в памяти и не ждут диск.
+// Поток журнала раз в JOURNAL_FLUSH_MS пишет накопленное одним write и
+// одним fdatasync (групповая фиксация), применяет записи к своей копии
+// состояния и, когда журнал вырастает до JOURNAL_SNAPSHOT_BYTES, пишет
+// её снимком через mmap и начинает новый файл журнала.
+//
+// В каталоге лежат snapshot.bin и journal-<номер>.bin. При запуске
+// читается снимок, затем журналы с его номера по порядку; оборванная
+// последняя запись отбрасывается.
+#define JOURNAL_DEFAULT_DIR "seabattle-data"
+#define JOURNAL_FLUSH_MS 10
+#define JOURNAL_SNAPSHOT_BYTES (64u << 20)
+
+// Загружает снимок и журнал в state (игроки и все живые игры вместе с
+// полями), записывает новый снимок и открывает новый журнал
+bool journal_open(const char *dir, Registry *state);
+
+// Раскладывает state по потокам: лобби получает игроков и каталог игр,
+// воркер - свои партии (game_id % worker_count)
+bool journal_restore(Registry *state, Registry *lobby,
+                     Registry *workers[], int worker_count);
+
+// Запускает поток журнала; состояние из journal_open переходит в его
+// владение
+bool journal_start(void);
+
+// Дописывает накопленные записи и останавливает поток журнала. Записи,
+// добавленные после вызова, теряются.
+void journal_stop(void);
+
+// Записи о событиях. Без journal_open ничего не делают.
+void journal_register(int64_t player_id, const char *login);
+void journal_logout(const char *login);
+void journal_create(int64_t game_id, const char *login, const char *name);
+void journal_join(int64_t game_id, const char *login);
+void journal_place_ship(int64_t game_id, int player, int x, int y, int size,
+                        int horizontal);
+void journal_place_fleet(int64_t game_id, int player,
+                         const uint8_t fleet[MAX_SHIPS]);
+void journal_shot(int64_t game_id, int player, int x, int y);
+void journal_finish(int64_t game_id);
+
+#endif // JOURNAL_H
@@ -0,0 +1,438 @@
+// Нагрузочный генератор: тысячи игроков без интерфейса проходят полный
+// цикл по обычному протоколу (регистрация, игра, расстановка, выстрелы
+// до конца партии) и меряют задержку ответов сервера. С -q игроки ищут
+// соперника через быструю игру, а не создают партии по имени.
+#include "common.h"
+#include "protocol.h"
+#include "stats.h"
+#include <errno.h>
+#include <pthread.h>
+
+#define MAX_THREADS 64
+#define FLEET_VARIANTS 64
+#define SHOT_STRIDE 37               // взаимно просто со 100: обход всех клеток
+#define DRAIN_NS 5000000000ull       // сколько ждать доигрывания партий
+#define POLL_TIMEOUT_MS 100
+
+typedef enum {
+  SIM_REGISTER,
+  SIM_IDLE,
+  SIM_CREATE,
+  SIM_MATCH,
+  SIM_WAIT_OPPONENT,
+  SIM_JOIN,
+  SIM_PLACE,
+  SIM_WAITING,
+  SIM_SHOOTING,
+  SIM_DONE
+} SimState;
+
+typedef struct SimPlayer {
+  void *socket;
+  char login[MAX_PLAYER_NAME];
+  struct SimPlayer *partner;
+  bool creator; // создаёт игры, партнёр присоединяется; с -q - получил пару
+                // ответом и считает партию
+  SimState state;
+  char game_name[MAX_GAME_NAME];
+  int64_t game_id;
+  int round;
+  int fleet;
+  int shots;
+  uint64_t session; // из ответа на регистрацию
+  MessageType pending; // запрос без ответа, 0 - нет
+  uint64_t sent_at;
+} SimPlayer;
+
+typedef struct {
+  int index;
+  int player_count;
+  SimPlayer *players;
+  int active_games;
+  uint64_t requests;
+  uint64_t received;
+  uint64_t games;
+  uint64_t errors;
+  Histogram latency[MSG_COUNT];
+} LoadThread;
+
+static const char *server_address = "tcp://localhost:" SERVER_PORT;
+static uint64_t deadline;
+static bool quick_mode;
+static uint8_t fleets[FLEET_VARIANTS][MAX_SHIPS];
+
+// Несколько готовых расстановок, чтобы не считать их на каждую партию
+static void make_fleets(void) {
+  uint32_t rng = 1;
+  for (int v = 0; v < FLEET_VARIANTS; v++) {
+    fleet_random(fleets[v], &rng);
+  }
+}
+
+// До регистрации игрок представляется логином, потом - дескриптором
+static void sim_send(LoadThread *lt, SimPlayer *p, Message *msg) {
+  if (p->session != 0) {
+    msg->session = p->session;
+  } else {
+    strncpy(msg->sender, p->login, MAX_PLAYER_NAME - 1);
+  }
+  msg->game_id = p->game_id;
+  p->pending = msg->type;
+  p->sent_at = stats_now_ns();
+  if (send_message(p->socket, msg)) {
+    lt->requests++;
+  } else {
+    lt->errors++;
+  }
+}
+
+static void sim_request(LoadThread *lt, SimPlayer *p, MessageType type,
+                        SimState state) {
+  Message msg = {0};
+  msg.type = type;
+  if (type == MSG_CREATE_GAME || type == MSG_JOIN_GAME) {
+    strncpy(msg.game_name, p->creator ? p->game_name : p->partner->game_name,
+            MAX_GAME_NAME - 1);
+  } else if (type == MSG_PLACE_FLEET) {
+    memcpy(msg.fleet, fleets[p->fleet], MAX_SHIPS);
+  }
+  p->state = state;
+  sim_send(lt, p, &msg);
+}
+
+static void sim_shoot(LoadThread *lt, SimPlayer *p) {
+  int cell = (p->fleet + p->shots * SHOT_STRIDE) % (BOARD_SIZE * BOARD_SIZE);
+  p->shots++;
+
+  Message msg = {0};
+  msg.type = MSG_MAKE_SHOT;
+  msg.x = cell % BOARD_SIZE;
+  msg.y = cell / BOARD_SIZE;
+  p->state = SIM_SHOOTING;
+  sim_send(lt, p, &msg);
+}
+
+// С -q каждый игрок сам встаёт в очередь, active_games считает игроков
+static void sim_next_match(LoadThread *lt, SimPlayer *p) {
+  if (p->state != SIM_IDLE) {
+    return;
+  }
+  if (stats_now_ns() >= deadline) {
+    p->state = SIM_DONE;
+    return;
+  }
+
+  p->game_id = 0;
+  p->shots = 0;
+  p->fleet = rand() % FLEET_VARIANTS;
+  lt->active_games++;
+  sim_request(lt, p, MSG_QUICK_MATCH, SIM_MATCH);
+}
+
+// Новая партия, когда оба игрока пары свободны
+static void sim_next_round(LoadThread *lt, SimPlayer *p) {
+  if (quick_mode) {
+    sim_next_match(lt, p);
+    return;
+  }
+  SimPlayer *creator = p->creator ? p : p->partner;
+  SimPlayer *joiner = creator->partner;
+  if (creator->state != SIM_IDLE || joiner->state != SIM_IDLE) {
+    return;
+  }
+  if (stats_now_ns() >= deadline) {
+    creator->state = joiner->state = SIM_DONE;
+    return;
+  }
+
+  creator->round++;
+  snprintf(creator->game_name, MAX_GAME_NAME, "%.36s-%d", creator->login,
+           creator->round);
+  creator->game_id = joiner->game_id = 0;
+  creator->shots = joiner->shots = 0;
+  creator->fleet = rand() % FLEET_VARIANTS;
+  joiner->fleet = rand() % FLEET_VARIANTS;
+  lt->active_games++;
+  sim_request(lt, creator, MSG_CREATE_GAME, SIM_CREATE);
+}
+
+static void sim_abort(LoadThread *lt, SimPlayer *p) {
+  lt->errors++;
+  if (quick_mode) {
+    if (p->state != SIM_REGISTER && p->state != SIM_IDLE &&
+        p->state != SIM_DONE) {
+      lt->active_games--;
+    }
+    p->state = SIM_DONE;
+    return;
+  }
+  if (p->state != SIM_REGISTER && p->partner->state != SIM_DONE) {
+    lt->active_games--;
+  }
+  p->state = p->partner->state = SIM_DONE;
+}
+
+static void sim_on_reply(LoadThread *lt, SimPlayer *p, Message *msg) {
+  if (p->pending != 0) {
+    hist_record(&lt->latency[p->pending], stats_now_ns() - p->sent_at);
+    p->pending = 0;
+  }
+  if (msg->type == MSG_ERROR) {
+    sim_abort(lt, p);
+    return;
+  }
+
+  switch (p->state) {
+  case SIM_REGISTER:
+    p->session = msg->session;
+    p->state = SIM_IDLE;
+    sim_next_round(lt, p);
+    break;
+  case SIM_CREATE:
+    p->game_id = p->partner->game_id = msg->game_id;
+    p->state = SIM_WAIT_OPPONENT;
+    sim_request(lt, p->partner, MSG_JOIN_GAME, SIM_JOIN);
+    break;
+  case SIM_MATCH:
+    p->game_id = msg->game_id;
+    p->creator = (msg->status == ST_MATCH_FOUND);
+    if (p->creator) {
+      sim_request(lt, p, MSG_PLACE_FLEET, SIM_PLACE);
+    } else {
+      p->state = SIM_WAIT_OPPONENT;
+    }
+    break;
+  case SIM_JOIN:
+    sim_request(lt, p, MSG_PLACE_FLEET, SIM_PLACE);
+    break;
+  case SIM_PLACE:
+  case SIM_SHOOTING:
+    p->state = SIM_WAITING;
+    break;
+  default:
+    break;
+  }
+}
+
+static void sim_on_push(LoadThread *lt, SimPlayer *p, Message *msg) {
+  switch (msg->type) {
+  case MSG_ACK: // соперник присоединился
+  case MSG_QUICK_MATCH:
+    if (p->state == SIM_WAIT_OPPONENT) {
+      p->game_id = msg->game_id;
+      sim_request(lt, p, MSG_PLACE_FLEET, SIM_PLACE);
+    }
+    break;
+  case MSG_GAME_STATE:
+    if (msg->status == ST_YOUR_TURN && p->state == SIM_WAITING) {
+      sim_shoot(lt, p);
+    }
+    break;
+  case MSG_GAME_OVER:
+    if (p->creator) {
+      lt->games++;
+    }
+    if (p->creator || quick_mode) {
+      lt->active_games--;
+    }
+    p->state = SIM_IDLE;
+    sim_next_round(lt, p);
+    break;
+  default:
+    break;
+  }
+}
+
+static bool sim_connect(LoadThread *lt, SimPlayer *p, void *context) {
+  p->socket = zmq_socket(context, ZMQ_DEALER);
+  zmq_setsockopt(p->socket, ZMQ_IDENTITY, p->login, strlen(p->login));
+  if (zmq_connect(p->socket, server_address) != 0) {
+    fprintf(stderr, "Error connecting to %s: %s\n", server_address,
+            zmq_strerror(errno));
+    return false;
+  }
+
+  Message msg = {0};
+  msg.type = MSG_REGISTER;
+  p->state = SIM_REGISTER;
+  sim_send(lt, p, &msg);
+  return true;
+}
+
+static void *load_thread(void *arg) {
+  LoadThread *lt = arg;
+  void *context = zmq_ctx_new();
+  zmq_pollitem_t *items = calloc(lt->player_count, sizeof(zmq_pollitem_t));
+
+  for (int i = 0; i < lt->player_count; i++) {
+    SimPlayer *p = &lt->players[i];
+    snprintf(p->login, MAX_PLAYER_NAME, "lg%d-%d-%d", (int)getpid(), lt->index,
+             i);
+    p->creator = (i % 2 == 0);
+    p->partner = &lt->players[i ^ 1];
+    if (!sim_connect(lt, p, context)) {
+      exit(1);
+    }
+    items[i] = (zmq_pollitem_t){p->socket, 0, ZMQ_POLLIN, 0};
+  }
+
+  while (1) {
+    uint64_t now = stats_now_ns();
+    if (now >= deadline && (lt->active_games == 0 || now >= deadline + DRAIN_NS))
+      break;
+
+    if (zmq_poll(items, lt->player_count, POLL_TIMEOUT_MS) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (int i = 0; i < lt->player_count; i++) {
+      if (!(items[i].revents & ZMQ_POLLIN))
+        continue;
+      SimPlayer *p = &lt->players[i];
+      Message msg;
+      while (receive_message_nonblock(p->socket, &msg)) {
+        lt->received++;
+        if (proto_is_push(&msg)) {
+          sim_on_push(lt, p, &msg);
+        } else {
+          sim_on_reply(lt, p, &msg);
+        }
+      }
+    }
+
+    // Пары, которые ждали свободного партнёра до дедлайна. С -q
+    // последнему в очереди соперник уже не придёт.
+    if (stats_now_ns() >= deadline) {
+      for (int i = 0; i < lt->player_count; i += quick_mode ? 1 : 2) {
+        SimPlayer *p = &lt->players[i];
+        if (quick_mode && p->state == SIM_WAIT_OPPONENT) {
+          p->state = SIM_DONE;
+          lt->active_games--;
+        }
+        sim_next_round(lt, p);
+      }
+    }
+  }
+
+  int linger = 1000;
+  for (int i = 0; i < lt->player_count; i++) {
+    Message logout = {0};
+    logout.type = MSG_LOGOUT;
+    logout.session = lt->players[i].session;
+    send_message(lt->players[i].socket, &logout);
+    zmq_setsockopt(lt->players[i].socket, ZMQ_LINGER, &linger, sizeof(linger));
+    zmq_close(lt->players[i].socket);
+  }
+  free(items);
+  zmq_ctx_destroy(context);
+  return NULL;
+}
+
+static void report(LoadThread *threads, int thread_count, int player_count,
+                   double seconds) {
+  static Histogram latency[MSG_COUNT];
+  uint64_t requests = 0, received = 0, games = 0, errors = 0;
+  for (int t = 0; t < thread_count; t++) {
+    requests += threads[t].requests;
+    received += threads[t].received;
+    games += threads[t].games;
+    errors += threads[t].errors;
+    for (int m = 0; m < MSG_COUNT; m++) {
+      hist_merge(&latency[m], &threads[t].latency[m]);
+    }
+  }
+
+  printf("Players:   %d in %d threads, %.1f s\n", player_count, thread_count,
+         seconds);
+  printf("Games:     %llu (%.1f/s)\n", (unsigned long long)games,
+         games / seconds);
+  printf("Messages:  %llu sent (%.0f/s), %llu received (%.0f/s)\n",
+         (unsigned long long)requests, requests / seconds,
+         (unsigned long long)received, received / seconds);
+  printf("Errors:    %llu\n\n", (unsigned long long)errors);
+
+  printf("%-12s %10s %10s %10s %10s %10s\n", "request", "count", "p50 us",
+         "p99 us", "p999 us", "max us");
+  for (int m = 0; m < MSG_COUNT; m++) {
+    Histogram *h = &latency[m];
+    if (h->total == 0)
+      continue;
+    printf("%-12s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+           message_type_name((MessageType)m), (unsigned long long)h->total,
+           hist_percentile(h, 0.5) / 1e3, hist_percentile(h, 0.99) / 1e3,
+           hist_percentile(h, 0.999) / 1e3, h->max / 1e3);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int thread_count = 4;
+  int player_count = 1000;
+  int seconds = 10;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:t:p:d:q")) != -1) {
+    switch (opt) {
+    case 's':
+      server_address = optarg;
+      break;
+    case 't':
+      thread_count = atoi(optarg);
+      break;
+    case 'p':
+      player_count = atoi(optarg);
+      break;
+    case 'd':
+      seconds = atoi(optarg);
+      break;
+    case 'q':
+      quick_mode = true;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-s tcp://host:port] [-t threads] [-p players] "
+              "[-d seconds] [-q]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  // Игроки делятся по потокам парами
+  int per_thread = player_count / (thread_count > 0 ? thread_count : 1) & ~1;
+  if (thread_count < 1 || thread_count > MAX_THREADS || per_thread < 2 ||
+      seconds < 1) {
+    fprintf(stderr, "Need 1..%d threads, at least 2 players per thread and "
+                    "a positive duration\n",
+            MAX_THREADS);
+    return 1;
+  }
+
+  make_fleets();
+
+  LoadThread *threads = calloc(thread_count, sizeof(LoadThread));
+  pthread_t tids[MAX_THREADS];
+  uint64_t start = stats_now_ns();
+  deadline = start + (uint64_t)seconds * 1000000000ull;
+
+  for (int t = 0; t < thread_count; t++) {
+    threads[t].index = t;
+    threads[t].player_count = per_thread;
+    threads[t].players = calloc(per_thread, sizeof(SimPlayer));
+    if (pthread_create(&tids[t], NULL, load_thread, &threads[t]) != 0) {
+      fprintf(stderr, "Error starting load thread\n");
+      return 1;
+    }
+  }
+  for (int t = 0; t < thread_count; t++) {
+    pthread_join(tids[t], NULL);
+  }
+
+  report(threads, thread_count, per_thread * thread_count,
+         (stats_now_ns() - start) / 1e9);
+
+  for (int t = 0; t < thread_count; t++) {
+    free(threads[t].players);
+  }
+  free(threads);
+  return 0;
+}
@@ -0,0 +1,595 @@
+#include "server.h"
+#include <stdio.h>
+
+// Отправитель запроса: по дескриптору сессии - прямое обращение к слоту,
+// старые клиенты без дескриптора ищутся по логину
+static Player *find_sender(ServerThread *t, const Message *msg) {
+  if (msg->session != 0) {
+    return registry_find_player_by_id(&t->registry, (int64_t)msg->session);
+  }
+  return registry_find_player(&t->registry, msg->sender);
+}
+
+static void handle_register(ServerThread *t, char *identity, Message *msg) {
+  // Логины ботов заняты воркерами
+  if (strncmp(msg->sender, BOT_LOGIN_PREFIX, strlen(BOT_LOGIN_PREFIX)) == 0 ||
+      registry_find_player(&t->registry, msg->sender)) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_REGISTERED);
+    return;
+  }
+
+  Player *p = registry_add_player(&t->registry, msg->sender, identity);
+  if (p == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_SERVER_FULL);
+    return;
+  }
+
+  journal_register(p->id, p->login);
+  p->last_seen = t->timers.now;
+  timer_arm(&t->timers, p->id, p->last_seen + timer_ticks(t->idle_limit));
+
+  // Дальше клиент подписывает запросы id своей записи вместо логина
+  Message response = {0};
+  response.type = MSG_ACK;
+  response.status = ST_REGISTERED;
+  response.session = (uint64_t)p->id;
+  server_send(t->socket, identity, &response);
+}
+
+// Игрок ждёт соперника для быстрой игры. Второй пришедший сразу
+// получает пару, поэтому очередь не длиннее одного игрока.
+static Player *match_waiting;
+static unsigned match_counter;
+static unsigned bot_counter;
+
+// Открытые игры по статусу: [0] - ждут соперника, [1] - расстановка.
+// Порядок - по номеру, который игра получает при входе в список.
+static GameList open_games[2];
+static uint32_t open_seq;
+
+static GameList *open_list(const Game *game) {
+  return &open_games[game->status == GAME_PLACING_SHIPS];
+}
+
+// Вызывать после смены статуса на GAME_WAITING или GAME_PLACING_SHIPS
+static void open_games_add(Game *game) {
+  game->list_seq = ++open_seq;
+  if (!game_list_append(open_list(game), game, game->list_seq)) {
+    game->list_seq = 0;
+    log_error("Game %d not listed: out of memory", game->id);
+  }
+}
+
+// Вызывать до смены статуса
+static void open_games_remove(Game *game) {
+  if (game->list_seq != 0) {
+    game_list_remove(open_list(game), game->list_seq);
+    game->list_seq = 0;
+  }
+}
+
+// Заводит партию или второго игрока на игровом воркере
+static void setup_on_worker(ServerThread *t, MessageType type, Game *game,
+                            Player *player) {
+  Message setup = {0};
+  setup.type = type;
+  setup.game_id = game->id;
+  strncpy(setup.sender, player->login, MAX_PLAYER_NAME - 1);
+  strncpy(setup.game_name, game->name, MAX_GAME_NAME - 1);
+  strncpy(setup.data, player->identity, MAX_MESSAGE_SIZE - 1);
+  setup.session = (uint64_t)player->id;
+  setup.x = (int)game->turn_limit;
+  internal_send(t->socket, &setup);
+}
+
+static void handle_create_game(ServerThread *t, char *identity, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_REGISTERED);
+    return;
+  }
+
+  if (player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_IN_GAME);
+    return;
+  }
+
+  if (registry_find_game_by_name(&t->registry, msg->game_name) != NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_GAME_EXISTS);
+    return;
+  }
+
+  Game *game = registry_create_game(&t->registry, msg->game_name, player);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CREATE_FAILED);
+    return;
+  }
+  // x - лимит хода в секундах, 0 - по умолчанию сервера
+  game->turn_limit = t->turn_limit;
+  if (msg->x > 0) {
+    game->turn_limit = msg->x < TURN_LIMIT_MIN   ? TURN_LIMIT_MIN
+                       : msg->x > TURN_LIMIT_MAX ? TURN_LIMIT_MAX
+                                                 : (uint32_t)msg->x;
+  }
+  journal_create(game->id, player->login, game->name);
+  open_games_add(game);
+
+  // Сначала заводим партию на игровом воркере, потом отвечаем клиенту:
+  // фронтенд доставит оба сообщения в этом же порядке
+  setup_on_worker(t, MSG_CREATE_GAME, game, player);
+
+  Message response = {0};
+  response.type = MSG_ACK;
+  response.game_id = game->id;
+  response.status = ST_GAME_CREATED;
+  server_send(t->socket, identity, &response);
+
+  log_info("Game '%s' created by %s (ID: %d)", game->name, player->login,
+           game->id);
+}
+
+static void handle_join_game(ServerThread *t, char *identity, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_REGISTERED);
+    return;
+  }
+
+  if (player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_name(&t->registry, msg->game_name);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_GAME_NOT_FOUND);
+    return;
+  }
+
+  // Партия с ботом занята, хотя игрок в ней у лобби один
+  if (game->player_count >= MAX_PLAYERS || game->status != GAME_WAITING) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_GAME_FULL);
+    return;
+  }
+
+  open_games_remove(game);
+  if (!registry_join_game(&t->registry, game, player)) {
+    open_games_add(game);
+    reply_status(t->socket, identity, MSG_ERROR, ST_JOIN_FAILED);
+    return;
+  }
+  open_games_add(game);
+  journal_join(game->id, player->login);
+
+  setup_on_worker(t, MSG_JOIN_GAME, game, player);
+
+  // Уведомление обоих игроков
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p != NULL) {
+      Message response = {0};
+      response.type = MSG_ACK;
+      response.game_id = game->id;
+      if (i == game->player_count - 1) {
+        response.status = ST_JOINED;
+      } else {
+        response.status = ST_OPPONENT_JOINED;
+        strncpy(response.sender, player->login, MAX_PLAYER_NAME - 1);
+      }
+      server_send(t->socket, p->identity, &response);
+    }
+  }
+
+  log_info("Player %s joined game '%s' (ID: %d)", player->login, game->name,
+           game->id);
+}
+
+// Быстрая игра: первый игрок встаёт в очередь, второй составляет с ним
+// пару. Партия создаётся сразу с двумя игроками под служебным именем.
+static void handle_quick_match(ServerThread *t, char *identity, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_REGISTERED);
+    return;
+  }
+
+  if (player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_IN_GAME);
+    return;
+  }
+
+  // Ждущий мог с тех пор сам создать игру или войти в чужую
+  if (match_waiting != NULL && match_waiting->in_game) {
+    match_waiting = NULL;
+  }
+  if (match_waiting == NULL || match_waiting == player) {
+    match_waiting = player;
+    reply_status(t->socket, identity, MSG_QUICK_MATCH, ST_MATCH_QUEUED);
+    return;
+  }
+
+  Player *opponent = match_waiting;
+  char name[MAX_GAME_NAME];
+  do {
+    snprintf(name, sizeof(name), "quick-%u", ++match_counter);
+  } while (registry_find_game_by_name(&t->registry, name) != NULL);
+
+  Game *game = registry_create_game(&t->registry, name, opponent);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CREATE_FAILED);
+    return;
+  }
+  game->turn_limit = t->turn_limit;
+  if (!registry_join_game(&t->registry, game, player)) {
+    registry_finish_game(&t->registry, game);
+    reply_status(t->socket, identity, MSG_ERROR, ST_JOIN_FAILED);
+    return;
+  }
+  match_waiting = NULL;
+  open_games_add(game);
+  journal_create(game->id, opponent->login, game->name);
+  journal_join(game->id, player->login);
+
+  setup_on_worker(t, MSG_CREATE_GAME, game, opponent);
+  setup_on_worker(t, MSG_JOIN_GAME, game, player);
+
+  Message response = {0};
+  response.type = MSG_QUICK_MATCH;
+  response.game_id = game->id;
+  strncpy(response.game_name, game->name, MAX_GAME_NAME - 1);
+
+  response.status = ST_MATCH_FOUND;
+  strncpy(response.sender, opponent->login, MAX_PLAYER_NAME - 1);
+  server_send(t->socket, identity, &response);
+
+  response.status = ST_OPPONENT_JOINED;
+  strncpy(response.sender, player->login, MAX_PLAYER_NAME - 1);
+  server_send(t->socket, opponent->identity, &response);
+
+  log_info("Quick match %s vs %s (ID: %d)", opponent->login, player->login,
+           game->id);
+}
+
+// Партия против бота сервера. Бот живёт только на воркере партии, у
+// лобби в ней один игрок; статус расстановки закрывает вход в партию и
+// снятие по тайм-ауту ожидания. В список открытых игр и в журнал такая
+// партия не попадает.
+static void handle_play_bot(ServerThread *t, char *identity, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_REGISTERED);
+    return;
+  }
+
+  if (player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_IN_GAME);
+    return;
+  }
+
+  char name[MAX_GAME_NAME];
+  do {
+    snprintf(name, sizeof(name), "bot-game-%u", ++bot_counter);
+  } while (registry_find_game_by_name(&t->registry, name) != NULL);
+
+  Game *game = registry_create_game(&t->registry, name, player);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CREATE_FAILED);
+    return;
+  }
+  if (player == match_waiting) {
+    match_waiting = NULL;
+  }
+  game->turn_limit = t->turn_limit;
+  game->status = GAME_PLACING_SHIPS;
+
+  setup_on_worker(t, MSG_PLAY_BOT, game, player);
+
+  Message response = {0};
+  response.type = MSG_PLAY_BOT;
+  response.status = ST_MATCH_FOUND;
+  response.game_id = game->id;
+  strncpy(response.game_name, game->name, MAX_GAME_NAME - 1);
+  snprintf(response.sender, MAX_PLAYER_NAME, BOT_LOGIN_PREFIX "%lld",
+           (long long)game->id);
+  server_send(t->socket, identity, &response);
+
+  log_info("Player %s plays against the bot (ID: %d)", player->login,
+           game->id);
+}
+
+static void handle_invite_player(ServerThread *t, char *identity, Message *msg) {
+  Player *inviter = find_sender(t, msg);
+  if (inviter == NULL || !inviter->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_id(&t->registry, inviter->game_id);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_GAME_NOT_FOUND);
+    return;
+  }
+
+  Player *invitee = registry_find_player(&t->registry, msg->recipient);
+  if (invitee == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_PLAYER_NOT_FOUND);
+    return;
+  }
+
+  if (invitee->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_PLAYER_BUSY);
+    return;
+  }
+
+  // Отправка приглашения
+  Message response = {0};
+  response.type = MSG_INVITE_PLAYER;
+  response.status = ST_INVITED;
+  strncpy(response.sender, inviter->login, MAX_PLAYER_NAME - 1);
+  strncpy(response.game_name, game->name, MAX_GAME_NAME - 1);
+  server_send(t->socket, invitee->identity, &response);
+
+  reply_status(t->socket, identity, MSG_ACK, ST_INVITE_SENT);
+
+  log_info("Player %s invited %s to game '%s'", inviter->login,
+           invitee->login, game->name);
+}
+
+// Страница списка открытых игр. Курсор - номер последней показанной
+// игры, страница заканчивается, когда следующая строка не помещается в
+// data. Обе очереди статусов уже упорядочены, для полного списка они
+// сливаются по номеру, так что стоимость не зависит от числа игр.
+static void handle_list_games(ServerThread *t, char *identity, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_REGISTERED);
+    return;
+  }
+
+  uint32_t cursor = (uint32_t)msg->x;
+  int filter = msg->y != 0 ? msg->y
+                           : (1 << GAME_WAITING) | (1 << GAME_PLACING_SHIPS);
+  GameList *lists[2] = {&open_games[0], &open_games[1]};
+  size_t pos[2];
+  for (int i = 0; i < 2; i++) {
+    bool wanted = filter & (1 << (i == 0 ? GAME_WAITING : GAME_PLACING_SHIPS));
+    pos[i] = wanted ? game_list_seek(lists[i], cursor) : lists[i]->count;
+  }
+
+  Message response = {0};
+  response.type = MSG_LIST_GAMES;
+  size_t len = 0;
+  if (cursor == 0) {
+    len = (size_t)snprintf(response.data, MAX_MESSAGE_SIZE,
+                           "Available games:\n");
+  }
+
+  int count = 0;
+  uint32_t last = 0;
+  bool more = false;
+  while (1) {
+    for (int i = 0; i < 2; i++) {
+      while (pos[i] < lists[i]->count && lists[i]->items[pos[i]].game == NULL)
+        pos[i]++;
+    }
+    int next = -1;
+    for (int i = 0; i < 2; i++) {
+      if (pos[i] < lists[i]->count &&
+          (next < 0 ||
+           lists[i]->items[pos[i]].seq < lists[next]->items[pos[next]].seq))
+        next = i;
+    }
+    if (next < 0) {
+      break;
+    }
+
+    const GameListEntry *e = &lists[next]->items[pos[next]];
+    size_t room = MAX_MESSAGE_SIZE - len;
+    int n = snprintf(response.data + len, room,
+                     "%lld. %s (%d/%d players)\n", (long long)e->game->id,
+                     e->game->name, e->game->player_count, MAX_PLAYERS);
+    if (n < 0 || (size_t)n >= room) {
+      response.data[len] = '\0';
+      more = true;
+      break;
+    }
+    len += (size_t)n;
+    last = e->seq;
+    count++;
+    pos[next]++;
+  }
+
+  response.x = more ? (int)last : 0;
+  response.y = count;
+  if (count == 0 && cursor == 0) {
+    response.data[0] = '\0';
+    response.status = ST_NO_GAMES;
+  }
+  server_send(t->socket, identity, &response);
+}
+
+// Клиент вышел: слот игрока возвращается в пул. Игрока в партии не
+// трогаем, его освободит конец игры.
+static void handle_logout(ServerThread *t, Message *msg) {
+  Player *player = find_sender(t, msg);
+  if (player == match_waiting) {
+    match_waiting = NULL;
+  }
+  if (player != NULL && !player->in_game) {
+    log_info("Player %s logged out", player->login);
+    journal_logout(player->login);
+    registry_remove_player(&t->registry, player);
+  }
+}
+
+// Воркер сообщил, что расстановка закончена и партия идёт
+static void handle_game_started(ServerThread *t, Message *msg) {
+  Game *game = registry_find_game_by_id(&t->registry, msg->game_id);
+  if (game != NULL && game->status != GAME_FINISHED) {
+    open_games_remove(game);
+    game->status = GAME_PLAYING;
+  }
+}
+
+// Отсчёт простоя игроков партии начинается с её конца
+static void touch_players(ServerThread *t, Game *game) {
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    if (game->player_refs[i] != NULL) {
+      game->player_refs[i]->last_seen = t->timers.now;
+    }
+  }
+}
+
+// Воркер завершил партию: освобождаем имя и игроков
+static void handle_game_finished(ServerThread *t, Message *msg) {
+  Game *game = registry_find_game_by_id(&t->registry, msg->game_id);
+  if (game != NULL && game->status != GAME_FINISHED) {
+    // Конец партии пишет в журнал воркер, у каталога журнал свой
+    if (t->sharded) {
+      journal_finish(game->id);
+    }
+    open_games_remove(game);
+    touch_players(t, game);
+    registry_finish_game(&t->registry, game);
+  }
+}
+
+// Открытая игра так и не дождалась соперника: снимаем её и у воркера
+static void cancel_waiting_game(ServerThread *t, Game *game) {
+  log_info("Game '%s' abandoned: no opponent", game->name);
+  open_games_remove(game);
+  journal_finish(game->id);
+
+  Message cancel = {0};
+  cancel.type = MSG_GAME_OVER;
+  cancel.game_id = game->id;
+  internal_send(t->socket, &cancel);
+
+  Message notice = {0};
+  notice.type = MSG_GAME_OVER;
+  notice.status = ST_GAME_ABANDONED;
+  notice.game_id = game->id;
+  strncpy(notice.game_name, game->name, MAX_GAME_NAME - 1);
+  Player *creator = game->player_refs[0];
+  if (creator != NULL) {
+    server_send(t->socket, creator->identity, &notice);
+  }
+
+  touch_players(t, game);
+  registry_finish_game(&t->registry, game);
+}
+
+// Простой игрока. Ждущий быстрой игры выходит из очереди, создатель
+// игры без соперника теряет игру, игрок вне партии выходит из лобби.
+// Игрока в идущей партии не трогаем: за ним следит таймер хода.
+static uint32_t player_timer(void *ctx, int64_t id, uint32_t now) {
+  ServerThread *t = ctx;
+  Player *player = registry_find_player_by_id(&t->registry, id);
+  if (player == NULL) {
+    return 0;
+  }
+  uint32_t idle = timer_ticks(t->idle_limit);
+  if (player->last_seen + idle > now) {
+    return player->last_seen + idle;
+  }
+
+  if (player == match_waiting) {
+    match_waiting = NULL;
+    reply_status(t->socket, player->identity, MSG_QUICK_MATCH,
+                 ST_MATCH_TIMEOUT);
+    player->last_seen = now;
+    return now + idle;
+  }
+  if (player->in_game) {
+    Game *game = registry_find_game_by_id(&t->registry, player->game_id);
+    if (game != NULL && game->status == GAME_WAITING) {
+      cancel_waiting_game(t, game);
+    }
+    return now + idle;
+  }
+
+  log_info("Player %s timed out", player->login);
+  journal_logout(player->login);
+  registry_remove_player(&t->registry, player);
+  return 0;
+}
+
+static void lobby_dispatch(ServerThread *t, char *identity, Message *msg) {
+  if (t->identity_len == 0) {
+    switch (msg->type) {
+    case MSG_GAME_STATE:
+      handle_game_started(t, msg);
+      break;
+    case MSG_GAME_OVER:
+      handle_game_finished(t, msg);
+      break;
+    default:
+      log_warn("Unknown internal message type: %d", msg->type);
+      break;
+    }
+    return;
+  }
+
+  Player *p = find_sender(t, msg);
+
+  // если уже зарегистрирован — обновим identity (reconnect)
+  if (p) {
+    registry_update_identity(p, identity, t->identity_len);
+    p->last_seen = t->timers.now;
+  }
+
+  switch (msg->type) {
+  case MSG_REGISTER:
+    handle_register(t, identity, msg);
+    break;
+  case MSG_CREATE_GAME:
+    handle_create_game(t, identity, msg);
+    break;
+  case MSG_JOIN_GAME:
+    handle_join_game(t, identity, msg);
+    break;
+  case MSG_INVITE_PLAYER:
+    handle_invite_player(t, identity, msg);
+    break;
+  case MSG_QUICK_MATCH:
+    handle_quick_match(t, identity, msg);
+    break;
+  case MSG_PLAY_BOT:
+    handle_play_bot(t, identity, msg);
+    break;
+  case MSG_LIST_GAMES:
+    handle_list_games(t, identity, msg);
+    break;
+  case MSG_LOGOUT:
+    handle_logout(t, msg);
+    break;
+  default:
+    log_warn("Unknown message type: %d", msg->type);
+    break;
+  }
+}
+
+void *lobby_main(void *arg) {
+  ServerThread *t = arg;
+  metrics_bind(t->metrics);
+
+  // Игры, восстановленные из журнала
+  size_t cursor = 0;
+  Game *g;
+  while ((g = registry_next_game(&t->registry, &cursor)) != NULL) {
+    if (g->status == GAME_WAITING || g->status == GAME_PLACING_SHIPS) {
+      open_games_add(g);
+    }
+    g->turn_limit = t->turn_limit;
+  }
+  // ...и игроки: отсчёт простоя - с перезапуска
+  Player *p;
+  cursor = 0;
+  while ((p = registry_next_player(&t->registry, &cursor)) != NULL) {
+    p->last_seen = 0;
+    timer_arm(&t->timers, p->id, timer_ticks(t->idle_limit));
+  }
+
+  server_thread_run(t, lobby_dispatch, player_timer);
+  return NULL;
+}
@@ -0,0 +1,209 @@
+#include "log.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_BATCH 256
+#define LOG_IDLE_US 1000
+
+// Ячейка кольца. seq показывает, чья очередь: pos - свободна для записи
+// с номером pos, pos + 1 - заполнена и ждёт потока вывода.
+typedef struct {
+  _Atomic uint64_t seq;
+  uint64_t time_ns;
+  const char *fmt;
+  uint8_t level;
+  uint8_t argc;
+  uint8_t strings; // бит i - аргумент i строка
+  union {
+    long long i;
+    char s[LOG_STRING_SIZE];
+  } args[LOG_MAX_ARGS];
+} LogRecord;
+
+static LogRecord ring[LOG_RING_SIZE];
+static _Atomic uint64_t head; // следующая позиция для писателей
+static uint64_t tail;         // только поток вывода
+static _Atomic uint64_t dropped;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+static void ring_init(void) {
+  for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+    atomic_store_explicit(&ring[i].seq, i, memory_order_relaxed);
+  }
+}
+
+void log_write(LogLevel level, const char *fmt, int argc, const LogArg *args) {
+  pthread_once(&ring_once, ring_init);
+
+  // Занимаем ячейку: CAS только на счётчике позиции
+  LogRecord *r;
+  uint64_t pos = atomic_load_explicit(&head, memory_order_relaxed);
+  while (1) {
+    r = &ring[pos & (LOG_RING_SIZE - 1)];
+    uint64_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+    int64_t diff = (int64_t)(seq - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+      return;
+    } else {
+      pos = atomic_load_explicit(&head, memory_order_relaxed);
+    }
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  r->time_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+  r->fmt = fmt;
+  r->level = (uint8_t)level;
+  r->argc = (uint8_t)(argc < LOG_MAX_ARGS ? argc : LOG_MAX_ARGS);
+  r->strings = 0;
+  for (int i = 0; i < r->argc; i++) {
+    if (args[i].is_string) {
+      r->strings |= (uint8_t)(1u << i);
+      const char *s = args[i].s ? args[i].s : "(null)";
+      size_t len = strnlen(s, LOG_STRING_SIZE - 1);
+      memcpy(r->args[i].s, s, len);
+      r->args[i].s[len] = '\0';
+    } else {
+      r->args[i].i = args[i].i;
+    }
+  }
+
+  atomic_store_explicit(&r->seq, pos + 1, memory_order_release);
+}
+
+uint64_t log_dropped(void) {
+  return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+// Подстановка аргументов по формату: каждая спецификация печатается
+// отдельным snprintf, целые - всегда как long long
+static size_t format_record(const LogRecord *r, char *out, size_t cap) {
+  static const char *level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+  time_t sec = (time_t)(r->time_ns / 1000000000ull);
+  struct tm tm;
+  localtime_r(&sec, &tm);
+  size_t len = (size_t)snprintf(out, cap, "%02d:%02d:%02d.%03d %-5s ",
+                                tm.tm_hour, tm.tm_min, tm.tm_sec,
+                                (int)(r->time_ns / 1000000 % 1000),
+                                level_names[r->level & 3]);
+
+  int arg = 0;
+  for (const char *p = r->fmt; *p && len < cap; p++) {
+    if (*p != '%') {
+      out[len++] = *p;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[len++] = '%';
+      p++;
+      continue;
+    }
+
+    // %[флаги][ширина][.точность][длина]преобразование
+    char spec[16] = "%";
+    size_t n = 1;
+    const char *q = p + 1;
+    while (*q && strchr("-+ #0123456789.", *q) && n < sizeof(spec) - 4) {
+      spec[n++] = *q++;
+    }
+    while (*q && strchr("hlzjt", *q)) {
+      q++;
+    }
+    char conv = *q;
+    if (conv == '\0') {
+      break;
+    }
+    p = q;
+
+    size_t room = cap - len;
+    int written = 0;
+    if (arg >= r->argc) {
+      written = snprintf(out + len, room, "?");
+    } else if (r->strings & (1u << arg)) {
+      spec[n++] = 's';
+      spec[n] = '\0';
+      written = snprintf(out + len, room, spec, r->args[arg].s);
+    } else if (conv == 'c') {
+      spec[n++] = 'c';
+      spec[n] = '\0';
+      written = snprintf(out + len, room, spec, (int)r->args[arg].i);
+    } else {
+      spec[n++] = 'l';
+      spec[n++] = 'l';
+      spec[n++] = strchr("uxXo", conv) ? conv : 'd';
+      spec[n] = '\0';
+      written = snprintf(out + len, room, spec, r->args[arg].i);
+    }
+    arg++;
+    if (written > 0) {
+      len += (size_t)written < room ? (size_t)written : room - 1;
+    }
+  }
+
+  if (len >= cap) {
+    len = cap - 1;
+  }
+  out[len++] = '\n';
+  return len;
+}
+
+// Вывод пачками: всё готовое на данный момент - одним fwrite
+static void *log_main(void *arg) {
+  (void)arg;
+  static char batch[LOG_BATCH * 512];
+  uint64_t reported = 0;
+
+  while (1) {
+    size_t len = 0;
+    int count = 0;
+    while (count < LOG_BATCH) {
+      LogRecord *r = &ring[tail & (LOG_RING_SIZE - 1)];
+      uint64_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+      if (seq != tail + 1)
+        break;
+
+      len += format_record(r, batch + len, 512);
+      atomic_store_explicit(&r->seq, tail + LOG_RING_SIZE,
+                            memory_order_release);
+      tail++;
+      count++;
+    }
+
+    uint64_t lost = log_dropped();
+    if (lost != reported && len + 64 < sizeof(batch)) {
+      len += (size_t)snprintf(batch + len, 64, "%llu log records dropped\n",
+                              (unsigned long long)(lost - reported));
+      reported = lost;
+    }
+
+    if (len > 0) {
+      fwrite(batch, 1, len, stdout);
+      fflush(stdout);
+    }
+    if (count < LOG_BATCH) {
+      usleep(LOG_IDLE_US);
+    }
+  }
+
+  return NULL;
+}
+
+bool log_start(void) {
+  pthread_once(&ring_once, ring_init);
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, log_main, NULL) != 0) {
+    return false;
+  }
+  pthread_detach(tid);
+  return true;
+}
@@ -0,0 +1,82 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Асинхронный журнал сообщений сервера.
+//
+// Обработчик не форматирует строку и не пишет в stdout: он кладёт в
+// кольцевой буфер запись фиксированного размера (уровень, время, формат и
+// до LOG_MAX_ARGS аргументов, строки копируются). Буфер без блокировок,
+// писателей может быть несколько. Фоновый поток форматирует записи и
+// выводит их пачками. Если буфер заполнен, запись отбрасывается и
+// учитывается в счётчике потерь - обработка сообщений не ждёт никогда.
+//
+// Формат - строковый литерал printf с %d/%u/%x/%s (модификаторы длины не
+// нужны, целые передаются как long long).
+
+typedef enum { LOG_DEBUG = 0, LOG_INFO, LOG_WARN, LOG_ERROR } LogLevel;
+
+// Записи ниже этого уровня не попадают в код. Отладочные сообщения
+// включаются сборкой с -DLOG_COMPILE_LEVEL=0 (опция SEABATTLE_DEBUG_LOG).
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_INFO
+#endif
+
+#define LOG_RING_SIZE 8192 // степень двойки
+#define LOG_MAX_ARGS 4
+#define LOG_STRING_SIZE 56
+
+typedef struct {
+  bool is_string;
+  union {
+    long long i;
+    const char *s;
+  };
+} LogArg;
+
+static inline LogArg log_arg_int(long long value) {
+  return (LogArg){.is_string = false, .i = value};
+}
+
+static inline LogArg log_arg_str(const char *value) {
+  return (LogArg){.is_string = true, .s = value};
+}
+
+#define LOG_ARG(x)                                                             \
+  _Generic((x), char *: log_arg_str, const char *: log_arg_str,               \
+           default: log_arg_int)(x)
+
+#define LOG_PACK0(fmt) fmt, 0, NULL
+#define LOG_PACK1(fmt, a) fmt, 1, (LogArg[]){LOG_ARG(a)}
+#define LOG_PACK2(fmt, a, b) fmt, 2, (LogArg[]){LOG_ARG(a), LOG_ARG(b)}
+#define LOG_PACK3(fmt, a, b, c)                                                \
+  fmt, 3, (LogArg[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c)}
+#define LOG_PACK4(fmt, a, b, c, d)                                             \
+  fmt, 4, (LogArg[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d)}
+#define LOG_SELECT(_1, _2, _3, _4, _5, name, ...) name
+#define LOG_PACK(...)                                                          \
+  LOG_SELECT(__VA_ARGS__, LOG_PACK4, LOG_PACK3, LOG_PACK2, LOG_PACK1,          \
+             LOG_PACK0, -)(__VA_ARGS__)
+
+#define log_at(level, ...)                                                     \
+  do {                                                                         \
+    if ((level) >= LOG_COMPILE_LEVEL)                                          \
+      log_write((level), LOG_PACK(__VA_ARGS__));                               \
+  } while (0)
+
+#define log_debug(...) log_at(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_WARN, __VA_ARGS__)
+#define log_error(...) log_at(LOG_ERROR, __VA_ARGS__)
+
+void log_write(LogLevel level, const char *fmt, int argc, const LogArg *args);
+
+// Поток вывода; до его запуска записи копятся в буфере
+bool log_start(void);
+
+// Отброшено из-за переполнения буфера с момента запуска
+uint64_t log_dropped(void);
+
+#endif // LOG_H
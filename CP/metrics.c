@@ -0,0 +1,208 @@
+#include "metrics.h"
+#include "protocol.h"
+#include <errno.h>
+#include <stdarg.h>
+
+#define METRICS_REPLY_SIZE 65536
+
+static ThreadMetrics *slots;
+static int slot_count;
+static uint64_t started_at;
+static char endpoint[64];
+static _Thread_local ThreadMetrics *current;
+
+bool metrics_init(int worker_count, const char *bind_endpoint) {
+  snprintf(endpoint, sizeof(endpoint), "%s", bind_endpoint);
+  slot_count = worker_count + 1;
+  slots = calloc((size_t)slot_count, sizeof(ThreadMetrics));
+  started_at = stats_now_ns();
+  return slots != NULL;
+}
+
+ThreadMetrics *metrics_slot(int slot) { return &slots[slot]; }
+
+void metrics_bind(ThreadMetrics *m) { current = m; }
+
+void metrics_error(StatusCode status) {
+  if (current != NULL && (unsigned)status < ST_COUNT) {
+    metric_add(&current->errors[status], 1);
+  }
+}
+
+void metrics_unsent(void) {
+  if (current != NULL) {
+    metric_add(&current->unsent, 1);
+  }
+}
+
+void metrics_message(ThreadMetrics *m, MessageType type, uint64_t ns) {
+  metric_add(&m->dequeued, 1);
+  if ((unsigned)type >= MSG_COUNT) {
+    return;
+  }
+
+  MessageMetrics *mm = &m->messages[type];
+  metric_add(&mm->count, 1);
+  metric_add(&mm->buckets[hist_bucket(ns)], 1);
+  if (ns > atomic_load_explicit(&mm->max_ns, memory_order_relaxed)) {
+    atomic_store_explicit(&mm->max_ns, ns, memory_order_relaxed);
+  }
+}
+
+void metrics_invalid(ThreadMetrics *m) {
+  metric_add(&m->dequeued, 1);
+  metric_add(&m->invalid, 1);
+}
+
+void metrics_gauges(ThreadMetrics *m, size_t players, size_t games) {
+  atomic_store_explicit(&m->players, players, memory_order_relaxed);
+  atomic_store_explicit(&m->games, games, memory_order_relaxed);
+}
+
+static uint64_t load(_Atomic uint64_t *counter) {
+  return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t cap;
+} Json;
+
+static void json_append(Json *j, const char *fmt, ...) {
+  if (j->len >= j->cap) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(j->buf + j->len, j->cap - j->len, fmt, args);
+  va_end(args);
+  if (n > 0) {
+    j->len += (size_t)n;
+  }
+}
+
+static void json_histogram(Json *j, const char *name, const Histogram *h,
+                           bool *first) {
+  json_append(j,
+              "%s\"%s\":{\"count\":%llu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+              "\"p999_us\":%.1f,\"max_us\":%.1f}",
+              *first ? "" : ",", name, (unsigned long long)h->total,
+              hist_percentile(h, 0.5) / 1e3, hist_percentile(h, 0.99) / 1e3,
+              hist_percentile(h, 0.999) / 1e3, h->max / 1e3);
+  *first = false;
+}
+
+// Сводка по всем потокам; чтение идёт параллельно с записью, поэтому
+// числа согласованы только приблизительно
+static size_t metrics_render(char *buf, size_t cap) {
+  Json j = {buf, 0, cap};
+  static Histogram merged[MSG_COUNT];
+  uint64_t errors[ST_COUNT] = {0};
+  uint64_t invalid = 0, queue_depth = 0, games_playing = 0;
+  uint64_t dropped = 0, unsent = 0;
+
+  for (int m = 0; m < MSG_COUNT; m++) {
+    hist_reset(&merged[m]);
+  }
+  for (int s = 0; s < slot_count; s++) {
+    ThreadMetrics *t = &slots[s];
+    for (int m = 0; m < MSG_COUNT; m++) {
+      MessageMetrics *mm = &t->messages[m];
+      if (load(&mm->count) == 0)
+        continue;
+      for (int b = 0; b < HIST_BUCKETS; b++) {
+        uint64_t c = load(&mm->buckets[b]);
+        merged[m].counts[b] += c;
+        merged[m].total += c;
+      }
+      uint64_t max = load(&mm->max_ns);
+      if (max > merged[m].max) {
+        merged[m].max = max;
+      }
+    }
+    for (int e = 0; e < ST_COUNT; e++) {
+      errors[e] += load(&t->errors[e]);
+    }
+    invalid += load(&t->invalid);
+    dropped += load(&t->dropped);
+    unsent += load(&t->unsent);
+    uint64_t in = load(&t->enqueued), out = load(&t->dequeued);
+    queue_depth += in > out ? in - out : 0;
+    if (s > 0) {
+      games_playing += load(&t->games);
+    }
+  }
+
+  json_append(&j,
+              "{\"uptime_s\":%.1f,\"players\":%llu,\"games\":%llu,"
+              "\"games_on_workers\":%llu,\"queue_depth\":%llu,\"invalid\":%llu",
+              (stats_now_ns() - started_at) / 1e9,
+              (unsigned long long)load(&slots[0].players),
+              (unsigned long long)load(&slots[0].games),
+              (unsigned long long)games_playing,
+              (unsigned long long)queue_depth, (unsigned long long)invalid);
+  json_append(&j, ",\"dropped\":%llu,\"unsent\":%llu",
+              (unsigned long long)dropped, (unsigned long long)unsent);
+
+  json_append(&j, ",\"queues\":[");
+  for (int s = 0; s < slot_count; s++) {
+    uint64_t in = load(&slots[s].enqueued), out = load(&slots[s].dequeued);
+    json_append(&j, "%s%llu", s ? "," : "",
+                (unsigned long long)(in > out ? in - out : 0));
+  }
+
+  json_append(&j, "],\"messages\":{");
+  bool first = true;
+  for (int m = 0; m < MSG_COUNT; m++) {
+    if (merged[m].total > 0) {
+      json_histogram(&j, message_type_name((MessageType)m), &merged[m],
+                     &first);
+    }
+  }
+
+  json_append(&j, "},\"errors\":{");
+  first = true;
+  for (int e = 0; e < ST_COUNT; e++) {
+    if (errors[e] > 0) {
+      json_append(&j, "%s\"%s\":%llu", first ? "" : ",",
+                  status_text((StatusCode)e), (unsigned long long)errors[e]);
+      first = false;
+    }
+  }
+  json_append(&j, "}}");
+
+  return j.len < cap ? j.len : cap - 1;
+}
+
+void *metrics_main(void *context) {
+  void *socket = zmq_socket(context, ZMQ_REP);
+  if (zmq_bind(socket, endpoint) != 0) {
+    fprintf(stderr, "Error binding metrics socket: %s\n", zmq_strerror(errno));
+    zmq_close(socket);
+    return NULL;
+  }
+
+  static char reply[METRICS_REPLY_SIZE];
+  while (1) {
+    char request[64];
+    if (zmq_recv(socket, request, sizeof(request), 0) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    // Запрос может быть многокадровым, дочитываем
+    int more = 0;
+    size_t more_size = sizeof(more);
+    while (zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size) == 0 &&
+           more) {
+      zmq_recv(socket, request, sizeof(request), 0);
+    }
+
+    size_t len = metrics_render(reply, sizeof(reply));
+    zmq_send(socket, reply, len, 0);
+  }
+
+  zmq_close(socket);
+  return NULL;
+}
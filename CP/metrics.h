@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+#include "stats.h"
+#include <stdatomic.h>
+
+#define METRICS_PORT_OFFSET 1 // от порта сервера
+
+// Метрики одного потока сервера. Пишет только сам поток (очередь -
+// фронтенд), поэтому запись - обычные load/store без блокировок и без
+// атомарных read-modify-write; поток метрик только читает.
+typedef struct {
+  _Atomic uint64_t count;
+  _Atomic uint64_t max_ns;
+  _Atomic uint64_t buckets[HIST_BUCKETS];
+} MessageMetrics;
+
+typedef struct {
+  MessageMetrics messages[MSG_COUNT]; // время от приёма до отправки ответа
+  _Atomic uint64_t errors[ST_COUNT];  // ответы MSG_ERROR по причине
+  _Atomic uint64_t invalid;           // кадры, которые не разобрались
+  _Atomic uint64_t enqueued;          // пишет фронтенд
+  _Atomic uint64_t dropped;           // кадры, не переданные фронтендом
+  _Atomic uint64_t unsent;            // ответы, не влезшие во фронтенд
+  _Atomic uint64_t dequeued;
+  _Atomic uint64_t players;
+  _Atomic uint64_t games;
+} ThreadMetrics;
+
+// slot 0 - лобби, slot i + 1 - воркер i
+bool metrics_init(int worker_count, const char *endpoint);
+ThreadMetrics *metrics_slot(int slot);
+
+// Метрики текущего потока, для записи ошибок из server_send
+void metrics_bind(ThreadMetrics *m);
+void metrics_error(StatusCode status);
+void metrics_unsent(void);
+
+void metrics_message(ThreadMetrics *m, MessageType type, uint64_t ns);
+void metrics_invalid(ThreadMetrics *m);
+void metrics_gauges(ThreadMetrics *m, size_t players, size_t games);
+
+static inline void metric_add(_Atomic uint64_t *counter, uint64_t value) {
+  atomic_store_explicit(
+      counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+      memory_order_relaxed);
+}
+
+// Поток REP-сокета: на любой запрос отвечает JSON со сводкой
+void *metrics_main(void *context);
+
+#endif // METRICS_H
@@ -0,0 +1,351 @@
+#include "protocol.h"
+
+typedef struct {
+  uint8_t *pos;
+  uint8_t *end;
+  bool ok;
+} Writer;
+
+typedef struct {
+  const uint8_t *pos;
+  const uint8_t *end;
+  bool ok;
+} Reader;
+
+static void put_byte(Writer *w, uint8_t b) {
+  if (w->pos >= w->end) {
+    w->ok = false;
+    return;
+  }
+  *w->pos++ = b;
+}
+
+static void put_varint(Writer *w, uint64_t v) {
+  while (v >= 0x80) {
+    put_byte(w, (uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  put_byte(w, (uint8_t)v);
+}
+
+static void put_int(Writer *w, int64_t v) {
+  put_varint(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void put_string(Writer *w, const char *s, size_t max) {
+  const char *nul = memchr(s, '\0', max - 1);
+  size_t len = nul ? (size_t)(nul - s) : max - 1;
+  put_varint(w, (uint32_t)len);
+  if (w->pos + len > w->end) {
+    w->ok = false;
+    return;
+  }
+  memcpy(w->pos, s, len);
+  w->pos += len;
+}
+
+static void put_bytes(Writer *w, const uint8_t *bytes, size_t len) {
+  if (w->pos + len > w->end) {
+    w->ok = false;
+    return;
+  }
+  memcpy(w->pos, bytes, len);
+  w->pos += len;
+}
+
+static bool is_zero(const uint8_t *bytes, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (bytes[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint8_t get_byte(Reader *r) {
+  if (r->pos >= r->end) {
+    r->ok = false;
+    return 0;
+  }
+  return *r->pos++;
+}
+
+static uint64_t get_varint(Reader *r) {
+  uint64_t v = 0;
+  for (int shift = 0; shift < 70 && r->ok; shift += 7) {
+    uint8_t b = get_byte(r);
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+  }
+  r->ok = false;
+  return 0;
+}
+
+static int64_t get_int(Reader *r) {
+  uint64_t v = get_varint(r);
+  return (int64_t)((v >> 1) ^ (~(v & 1) + 1));
+}
+
+static void get_bytes(Reader *r, uint8_t *dst, size_t len) {
+  if (len > (size_t)(r->end - r->pos)) {
+    r->ok = false;
+    return;
+  }
+  memcpy(dst, r->pos, len);
+  r->pos += len;
+}
+
+static void get_string(Reader *r, char *dst, size_t max) {
+  uint64_t len = get_varint(r);
+  if (!r->ok || len >= max || len > (size_t)(r->end - r->pos)) {
+    r->ok = false;
+    dst[0] = '\0';
+    return;
+  }
+  memcpy(dst, r->pos, len);
+  dst[len] = '\0';
+  r->pos += len;
+}
+
+size_t proto_encode(const Message *msg, uint8_t *buf, size_t cap) {
+  uint32_t mask = 0;
+  mask |= msg->x ? FIELD_X : 0;
+  mask |= msg->y ? FIELD_Y : 0;
+  mask |= msg->game_id ? FIELD_GAME_ID : 0;
+  mask |= msg->shot_result ? FIELD_SHOT_RESULT : 0;
+  mask |= msg->status ? FIELD_STATUS : 0;
+  mask |= msg->sender[0] ? FIELD_SENDER : 0;
+  mask |= msg->recipient[0] ? FIELD_RECIPIENT : 0;
+  mask |= msg->game_name[0] ? FIELD_GAME_NAME : 0;
+  mask |= msg->data[0] ? FIELD_DATA : 0;
+  mask |= is_zero(msg->fleet, MAX_SHIPS) ? 0 : FIELD_FLEET;
+  mask |= msg->session ? FIELD_SESSION : 0;
+
+  // Тело пишем с запасом под 2 байта длины, потом при необходимости сдвигаем
+  if (cap < 3) {
+    return 0;
+  }
+  Writer w = {buf + 3, buf + cap, true};
+  put_byte(&w, (uint8_t)msg->type);
+  put_varint(&w, mask);
+  if (mask & FIELD_X)
+    put_int(&w, msg->x);
+  if (mask & FIELD_Y)
+    put_int(&w, msg->y);
+  if (mask & FIELD_GAME_ID)
+    put_int(&w, msg->game_id);
+  if (mask & FIELD_SHOT_RESULT)
+    put_varint(&w, (uint32_t)msg->shot_result);
+  if (mask & FIELD_STATUS)
+    put_varint(&w, (uint32_t)msg->status);
+  if (mask & FIELD_SENDER)
+    put_string(&w, msg->sender, MAX_PLAYER_NAME);
+  if (mask & FIELD_RECIPIENT)
+    put_string(&w, msg->recipient, MAX_PLAYER_NAME);
+  if (mask & FIELD_GAME_NAME)
+    put_string(&w, msg->game_name, MAX_GAME_NAME);
+  if (mask & FIELD_DATA)
+    put_string(&w, msg->data, MAX_MESSAGE_SIZE);
+  if (mask & FIELD_FLEET)
+    put_bytes(&w, msg->fleet, MAX_SHIPS);
+  if (mask & FIELD_SESSION)
+    put_varint(&w, msg->session);
+
+  size_t body = (size_t)(w.pos - (buf + 3));
+  if (!w.ok || body >= (1u << 14)) {
+    return 0;
+  }
+
+  buf[0] = PROTO_VERSION;
+  if (body < 0x80) {
+    buf[1] = (uint8_t)body;
+    memmove(buf + 2, buf + 3, body);
+    return body + 2;
+  }
+  buf[1] = (uint8_t)(body | 0x80);
+  buf[2] = (uint8_t)(body >> 7);
+  return body + 3;
+}
+
+bool proto_decode(const uint8_t *buf, size_t len, Message *msg) {
+  Reader r = {buf, buf + len, true};
+  if (get_byte(&r) != PROTO_VERSION) {
+    return false;
+  }
+  uint64_t body = get_varint(&r);
+  if (!r.ok || body != (size_t)(r.end - r.pos)) {
+    return false;
+  }
+
+  // Чистим только заголовки полей, а не весь буфер data
+  msg->type = (MessageType)get_byte(&r);
+  msg->x = msg->y = msg->game_id = 0;
+  msg->session = 0;
+  msg->shot_result = SHOT_MISS;
+  msg->status = ST_NONE;
+  msg->sender[0] = msg->recipient[0] = msg->game_name[0] = msg->data[0] = '\0';
+  memset(msg->fleet, 0, MAX_SHIPS);
+
+  uint32_t mask = (uint32_t)get_varint(&r);
+  if (mask & FIELD_X)
+    msg->x = (int)get_int(&r);
+  if (mask & FIELD_Y)
+    msg->y = (int)get_int(&r);
+  if (mask & FIELD_GAME_ID)
+    msg->game_id = get_int(&r);
+  if (mask & FIELD_SHOT_RESULT)
+    msg->shot_result = (ShotResult)get_varint(&r);
+  if (mask & FIELD_STATUS)
+    msg->status = (StatusCode)get_varint(&r);
+  if (mask & FIELD_SENDER)
+    get_string(&r, msg->sender, MAX_PLAYER_NAME);
+  if (mask & FIELD_RECIPIENT)
+    get_string(&r, msg->recipient, MAX_PLAYER_NAME);
+  if (mask & FIELD_GAME_NAME)
+    get_string(&r, msg->game_name, MAX_GAME_NAME);
+  if (mask & FIELD_DATA)
+    get_string(&r, msg->data, MAX_MESSAGE_SIZE);
+  if (mask & FIELD_FLEET)
+    get_bytes(&r, msg->fleet, MAX_SHIPS);
+  if (mask & FIELD_SESSION)
+    msg->session = get_varint(&r);
+
+  return r.ok && r.pos == r.end;
+}
+
+bool proto_peek(const uint8_t *buf, size_t len, MessageType *type,
+                int64_t *game_id) {
+  Reader r = {buf, buf + len, true};
+  if (get_byte(&r) != PROTO_VERSION) {
+    return false;
+  }
+  get_varint(&r);
+  *type = (MessageType)get_byte(&r);
+  *game_id = 0;
+
+  uint32_t mask = (uint32_t)get_varint(&r);
+  if (mask & FIELD_X)
+    get_varint(&r);
+  if (mask & FIELD_Y)
+    get_varint(&r);
+  if (mask & FIELD_GAME_ID)
+    *game_id = get_int(&r);
+  return r.ok;
+}
+
+bool proto_is_push(const Message *msg) {
+  switch (msg->type) {
+  case MSG_GAME_STATE:
+  case MSG_GAME_OVER:
+  case MSG_INVITE_PLAYER:
+    return true;
+  case MSG_SHOT_RESULT:
+    return msg->status == ST_OPPONENT_SHOT;
+  case MSG_ACK:
+    return msg->status == ST_OPPONENT_JOINED;
+  case MSG_QUICK_MATCH:
+    return msg->status == ST_OPPONENT_JOINED ||
+           msg->status == ST_MATCH_TIMEOUT;
+  default:
+    return false;
+  }
+}
+
+bool proto_client_identity(const void *identity, size_t size) {
+  return size > 0 && memchr(identity, 0, size) == NULL;
+}
+
+bool proto_is_game_request(MessageType type) {
+  switch (type) {
+  case MSG_PLACE_SHIP:
+  case MSG_PLACE_FLEET:
+  case MSG_MAKE_SHOT:
+  case MSG_GAME_STATE:
+  case MSG_GAME_OVER:
+    return true;
+  default:
+    return false;
+  }
+}
+
+const char *status_text(StatusCode status) {
+  static const char *texts[ST_COUNT] = {
+      [ST_NONE] = "",
+      [ST_REGISTERED] = "Registered",
+      [ST_ALREADY_REGISTERED] = "Already registered",
+      [ST_SERVER_FULL] = "Server is full",
+      [ST_NOT_REGISTERED] = "Player not registered",
+      [ST_ALREADY_IN_GAME] = "Already in a game",
+      [ST_GAME_EXISTS] = "Game name already exists",
+      [ST_CREATE_FAILED] = "Failed to create game",
+      [ST_GAME_CREATED] = "Game created successfully",
+      [ST_GAME_NOT_FOUND] = "Game not found",
+      [ST_GAME_FULL] = "Game is full",
+      [ST_JOIN_FAILED] = "Failed to join game",
+      [ST_JOINED] = "Joined game successfully. Start placing ships!",
+      [ST_OPPONENT_JOINED] = "Opponent joined the game. Start placing ships!",
+      [ST_NOT_IN_GAME] = "You are not in a game",
+      [ST_PLAYER_NOT_FOUND] = "Player not found",
+      [ST_PLAYER_BUSY] = "Player is already in a game",
+      [ST_INVITED] = "You are invited to a game",
+      [ST_INVITE_SENT] = "Invitation sent",
+      [ST_CANNOT_PLACE] = "Cannot place ship now",
+      [ST_SHIP_PLACED] = "Ship placed successfully",
+      [ST_INVALID_PLACEMENT] = "Invalid ship placement",
+      [ST_YOUR_TURN] = "Your turn!",
+      [ST_OPPONENT_TURN] = "Opponent's turn",
+      [ST_OPPONENT_PREPARING] = "Opponent is getting ready...",
+      [ST_CANNOT_SHOOT] = "Cannot make shot now",
+      [ST_NOT_YOUR_TURN] = "Not your turn",
+      [ST_INVALID_COORDS] = "Invalid coordinates",
+      [ST_ALREADY_SHOT] = "Already shot here",
+      [ST_OPPONENT_SHOT] = "Opponent fired",
+      [ST_YOU_WON] = "You won!",
+      [ST_YOU_LOST] = "You lost!",
+      [ST_NO_GAMES] = "No available games",
+      [ST_FLEET_PLACED] = "Fleet placed successfully",
+      [ST_INVALID_FLEET] = "Invalid fleet placement",
+      [ST_MATCH_QUEUED] = "Waiting for an opponent",
+      [ST_MATCH_FOUND] = "Opponent found",
+      [ST_MATCH_TIMEOUT] = "No opponent found in time",
+      [ST_GAME_ABANDONED] = "Game abandoned: time is up",
+      [ST_TIMED_OUT] = "Time is up, you lost!",
+      [ST_OPPONENT_TIMED_OUT] = "Opponent ran out of time, you won!",
+      [ST_SERVER_BUSY] = "Server is busy, try again",
+  };
+
+  if ((unsigned)status >= ST_COUNT || texts[status] == NULL) {
+    return "Unknown status";
+  }
+  return texts[status];
+}
+
+const char *message_type_name(MessageType type) {
+  static const char *names[MSG_COUNT] = {
+      [MSG_REGISTER] = "register",
+      [MSG_CREATE_GAME] = "create_game",
+      [MSG_JOIN_GAME] = "join_game",
+      [MSG_INVITE_PLAYER] = "invite_player",
+      [MSG_GAME_STATE] = "game_state",
+      [MSG_TURN_ORDER] = "turn_order",
+      [MSG_PLACE_SHIP] = "place_ship",
+      [MSG_MAKE_SHOT] = "make_shot",
+      [MSG_SHOT_RESULT] = "shot_result",
+      [MSG_GAME_OVER] = "game_over",
+      [MSG_ERROR] = "error",
+      [MSG_ACK] = "ack",
+      [MSG_LIST_GAMES] = "list_games",
+      [MSG_LIST_PLAYERS] = "list_players",
+      [MSG_LOGOUT] = "logout",
+      [MSG_PLACE_FLEET] = "place_fleet",
+      [MSG_QUICK_MATCH] = "quick_match",
+      [MSG_PLAY_BOT] = "play_bot",
+  };
+
+  if ((unsigned)type >= MSG_COUNT || names[type] == NULL) {
+    return "unknown";
+  }
+  return names[type];
+}
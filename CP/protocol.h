@@ -0,0 +1,56 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "common.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Бинарный формат кадра:
+//   [версия:1][длина тела:varint][тип:1][маска полей:varint][поля...]
+// Поля идут в порядке битов маски и передаются, только если отличны
+// от нуля: числа - zigzag varint, строки - varint длина + байты,
+// расстановка флота - MAX_SHIPS байт как есть, сессия - varint. id игры
+// и сессия - 64-битные id записей реестра.
+#define PROTO_VERSION 2
+#define PROTO_MAX_FRAME (MAX_MESSAGE_SIZE + 3 * MAX_PLAYER_NAME + 64)
+
+enum {
+  FIELD_X = 1 << 0,
+  FIELD_Y = 1 << 1,
+  FIELD_GAME_ID = 1 << 2,
+  FIELD_SHOT_RESULT = 1 << 3,
+  FIELD_STATUS = 1 << 4,
+  FIELD_SENDER = 1 << 5,
+  FIELD_RECIPIENT = 1 << 6,
+  FIELD_GAME_NAME = 1 << 7,
+  FIELD_DATA = 1 << 8,
+  FIELD_FLEET = 1 << 9,
+  FIELD_SESSION = 1 << 10
+};
+
+// Возвращает длину кадра или 0, если не хватило места
+size_t proto_encode(const Message *msg, uint8_t *buf, size_t cap);
+// false для чужой версии или повреждённого кадра
+bool proto_decode(const uint8_t *buf, size_t len, Message *msg);
+
+// Разбор только заголовка: тип и game_id, без копирования строк
+bool proto_peek(const uint8_t *buf, size_t len, MessageType *type,
+                int64_t *game_id);
+
+// Сообщения, которые сервер присылает сам, а не в ответ на запрос
+bool proto_is_push(const Message *msg);
+
+// Запросы по партии: их обрабатывает владелец game_id, остальные - лобби
+bool proto_is_game_request(MessageType type);
+
+// Identity клиента: непустая и без нулевых байтов. Пустая помечает
+// внутренние сообщения, а ROUTER выдаёт пиру без ZMQ_IDENTITY
+// identity, начинающуюся с 0x00 - она не годится как строка и не должна
+// выдавать себя за внутреннюю.
+bool proto_client_identity(const void *identity, size_t size);
+
+const char *status_text(StatusCode status);
+// Короткое имя типа для логов и метрик
+const char *message_type_name(MessageType type);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,72 @@
+#include "reactor.h"
+#include "log.h"
+#include "stats.h"
+#include <errno.h>
+#include <string.h>
+
+void reactor_init(Reactor *r, int batch) {
+  memset(r, 0, sizeof(*r));
+  r->batch = batch > 0 ? batch : 1;
+}
+
+static bool add_source(Reactor *r, void *socket, int fd, ReactorRead read,
+                       void *ctx) {
+  if (r->count == REACTOR_MAX_SOURCES) {
+    return false;
+  }
+  r->items[r->count] = (zmq_pollitem_t){socket, fd, ZMQ_POLLIN, 0};
+  r->reads[r->count] = read;
+  r->contexts[r->count] = ctx;
+  r->count++;
+  return true;
+}
+
+bool reactor_add_socket(Reactor *r, void *socket, ReactorRead read,
+                        void *ctx) {
+  return add_source(r, socket, -1, read, ctx);
+}
+
+bool reactor_add_fd(Reactor *r, int fd, ReactorRead read, void *ctx) {
+  return add_source(r, NULL, fd, read, ctx);
+}
+
+void reactor_set_timers(Reactor *r, TimerWheel *timers, TimerFire fire,
+                        void *ctx) {
+  r->timers = timers;
+  r->fire = fire;
+  r->fire_ctx = ctx;
+}
+
+void reactor_stop(Reactor *r) { r->stopped = true; }
+
+void reactor_run(Reactor *r) {
+  r->stopped = false;
+  while (!r->stopped) {
+    int timeout = -1;
+    if (r->timers != NULL) {
+      timer_wheel_advance(r->timers, stats_now_ns(), r->fire, r->fire_ctx);
+      timeout = timer_wheel_timeout_ms(r->timers, stats_now_ns());
+    }
+
+    int ready = zmq_poll(r->items, r->count, timeout);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      log_error("zmq_poll failed: %s", zmq_strerror(errno));
+      break;
+    }
+
+    // Недочитанное сверх пачки останется готовым к следующему опросу
+    for (int i = 0; i < r->count && ready > 0; i++) {
+      if (!(r->items[i].revents & ZMQ_POLLIN)) {
+        continue;
+      }
+      ready--;
+      for (int n = 0; n < r->batch; n++) {
+        if (!r->reads[i](r->contexts[i], r->items[i].socket)) {
+          break;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "timer.h"
+#include <zmq.h>
+
+// Цикл событий потока сервера на zmq_poll.
+//
+// Источники - сокеты ZeroMQ и файловые дескрипторы (eventfd для
+// пробуждения из обработчика сигнала). За одно пробуждение из каждого
+// готового источника забирается до batch сообщений: под нагрузкой один
+// zmq_poll обслуживает пачку, а не одно сообщение, и ни один источник
+// не занимает поток целиком. Если у потока есть колесо таймеров, цикл
+// ждёт не дольше следующего тика и продвигает колесо перед каждым
+// опросом.
+#define REACTOR_MAX_SOURCES 80
+#define REACTOR_BATCH 64
+
+// Забирает одно сообщение источника; false - очередь пуста. Для
+// дескриптора socket - NULL.
+typedef bool (*ReactorRead)(void *ctx, void *socket);
+
+typedef struct {
+  zmq_pollitem_t items[REACTOR_MAX_SOURCES];
+  ReactorRead reads[REACTOR_MAX_SOURCES];
+  void *contexts[REACTOR_MAX_SOURCES];
+  int count;
+  int batch;
+  TimerWheel *timers;
+  TimerFire fire;
+  void *fire_ctx;
+  bool stopped;
+} Reactor;
+
+void reactor_init(Reactor *r, int batch);
+bool reactor_add_socket(Reactor *r, void *socket, ReactorRead read,
+                        void *ctx);
+bool reactor_add_fd(Reactor *r, int fd, ReactorRead read, void *ctx);
+void reactor_set_timers(Reactor *r, TimerWheel *timers, TimerFire fire,
+                        void *ctx);
+
+// Работает до reactor_stop из обработчика или до ошибки zmq_poll
+void reactor_run(Reactor *r);
+void reactor_stop(Reactor *r);
+
+#endif // REACTOR_H
@@ -0,0 +1,666 @@
+#include "registry.h"
+
+// FNV-1a
+static uint32_t hash_string(const char *s) {
+  uint32_t h = 2166136261u;
+  while (*s) {
+    h ^= (unsigned char)*s++;
+    h *= 16777619u;
+  }
+  return h ? h : 1;
+}
+
+typedef bool (*IndexMatch)(const void *item, const void *key);
+
+static bool index_init(HashIndex *ix, size_t capacity) {
+  // Держим заполнение не выше 50%
+  size_t size = 16;
+  while (size < capacity * 2) {
+    size <<= 1;
+  }
+
+  ix->hashes = calloc(size, sizeof(uint32_t));
+  ix->items = calloc(size, sizeof(void *));
+  ix->mask = size - 1;
+  ix->count = 0;
+  return ix->hashes != NULL && ix->items != NULL;
+}
+
+static void index_free(HashIndex *ix) {
+  free(ix->hashes);
+  free(ix->items);
+  ix->hashes = NULL;
+  ix->items = NULL;
+}
+
+// Возвращает позицию слота или -1
+static long index_find(const HashIndex *ix, uint32_t hash, IndexMatch match,
+                       const void *key) {
+  size_t i = hash & ix->mask;
+  while (ix->hashes[i] != 0) {
+    if (ix->hashes[i] == hash && match(ix->items[i], key)) {
+      return (long)i;
+    }
+    i = (i + 1) & ix->mask;
+  }
+  return -1;
+}
+
+static void index_put(HashIndex *ix, uint32_t hash, void *item) {
+  size_t i = hash & ix->mask;
+  while (ix->hashes[i] != 0) {
+    i = (i + 1) & ix->mask;
+  }
+  ix->hashes[i] = hash;
+  ix->items[i] = item;
+  ix->count++;
+}
+
+// Перестройка в таблицу под capacity элементов
+static bool index_resize(HashIndex *ix, size_t capacity) {
+  HashIndex bigger;
+  if (!index_init(&bigger, capacity)) {
+    index_free(&bigger);
+    return false;
+  }
+  for (size_t i = 0; i <= ix->mask; i++) {
+    if (ix->hashes[i] != 0) {
+      index_put(&bigger, ix->hashes[i], ix->items[i]);
+    }
+  }
+  index_free(ix);
+  *ix = bigger;
+  return true;
+}
+
+// Вдвое больше
+static bool index_grow(HashIndex *ix) { return index_resize(ix, ix->mask + 1); }
+
+static bool index_reserve(HashIndex *ix, size_t capacity) {
+  return capacity * 2 <= ix->mask + 1 || index_resize(ix, capacity);
+}
+
+static bool index_insert(HashIndex *ix, uint32_t hash, void *item) {
+  if ((ix->count + 1) * 2 > ix->mask + 1 && !index_grow(ix)) {
+    return false;
+  }
+  index_put(ix, hash, item);
+  return true;
+}
+
+// Удаление со сдвигом назад, без "надгробий"
+static void index_remove_at(HashIndex *ix, size_t i) {
+  size_t j = i;
+  while (1) {
+    j = (j + 1) & ix->mask;
+    if (ix->hashes[j] == 0) {
+      break;
+    }
+    size_t home = ix->hashes[j] & ix->mask;
+    // Элемент из j можно перенести в i, если его домашний слот не лежит
+    // в циклическом интервале (i, j]
+    bool between = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+    if (!between) {
+      ix->hashes[i] = ix->hashes[j];
+      ix->items[i] = ix->items[j];
+      i = j;
+    }
+  }
+  ix->hashes[i] = 0;
+  ix->items[i] = NULL;
+  ix->count--;
+}
+
+static void index_remove(HashIndex *ix, uint32_t hash, IndexMatch match,
+                         const void *key) {
+  long pos = index_find(ix, hash, match, key);
+  if (pos >= 0) {
+    index_remove_at(ix, (size_t)pos);
+  }
+}
+
+#define POOL_USED UINT32_MAX
+#define POOL_NONE (UINT32_MAX - 1)
+#define POOL_RETIRED (UINT32_MAX - 2)
+
+static void pool_init(Pool *pool, size_t item_size) {
+  memset(pool, 0, sizeof(*pool));
+  pool->item_size = item_size;
+  pool->free_head = POOL_NONE;
+  pool->free_tail = POOL_NONE;
+  pool->first_generation = 1; // id 0 не выдаётся
+}
+
+// Слот в конец очереди свободных
+static void pool_push_free(Pool *pool, uint32_t slot) {
+  pool->next_free[slot] = POOL_NONE;
+  if (pool->free_tail == POOL_NONE) {
+    pool->free_head = slot;
+  } else {
+    pool->next_free[pool->free_tail] = slot;
+  }
+  pool->free_tail = slot;
+}
+
+static void pool_free_all(Pool *pool) {
+  for (size_t i = 0; i < pool->block_count; i++) {
+    free(pool->blocks[i]);
+  }
+  free(pool->blocks);
+  free(pool->slabs);
+  free(pool->generations);
+  free(pool->next_free);
+  pool_init(pool, pool->item_size);
+}
+
+static void *pool_at(const Pool *pool, uint32_t slot) {
+  return pool->slabs[slot / POOL_SLAB_SIZE] +
+         (size_t)(slot % POOL_SLAB_SIZE) * pool->item_size;
+}
+
+// Новые куски записей, не меньше чем до capacity слотов; их слоты уходят
+// в очередь свободных. Куски одного роста лежат в одном блоке: большой
+// calloc - это отдельный mmap, и резерв под сотни тысяч записей иначе
+// упирается в системные вызовы.
+static bool pool_grow(Pool *pool, size_t capacity) {
+  size_t slab_count = (capacity + POOL_SLAB_SIZE - 1) / POOL_SLAB_SIZE;
+  if (slab_count <= pool->slab_count) {
+    slab_count = pool->slab_count + 1;
+  }
+  capacity = slab_count * POOL_SLAB_SIZE;
+  if (capacity > POOL_MAX_SLOTS ||
+      pool->first_generation > POOL_GENERATION_MAX) {
+    return false;
+  }
+
+  char **slabs = realloc(pool->slabs, slab_count * sizeof(char *));
+  if (slabs == NULL) {
+    return false;
+  }
+  pool->slabs = slabs;
+
+  char **blocks =
+      realloc(pool->blocks, (pool->block_count + 1) * sizeof(char *));
+  if (blocks == NULL) {
+    return false;
+  }
+  pool->blocks = blocks;
+
+  uint32_t *generations =
+      realloc(pool->generations, capacity * sizeof(uint32_t));
+  if (generations == NULL) {
+    return false;
+  }
+  pool->generations = generations;
+
+  uint32_t *next_free = realloc(pool->next_free, capacity * sizeof(uint32_t));
+  if (next_free == NULL) {
+    return false;
+  }
+  pool->next_free = next_free;
+
+  size_t slab_bytes = POOL_SLAB_SIZE * pool->item_size;
+  char *block = calloc(slab_count - pool->slab_count, slab_bytes);
+  if (block == NULL) {
+    return false;
+  }
+  pool->blocks[pool->block_count++] = block;
+  for (size_t i = pool->slab_count; i < slab_count; i++) {
+    pool->slabs[i] = block + (i - pool->slab_count) * slab_bytes;
+  }
+  pool->slab_count = slab_count;
+
+  // Слоты выдаются по возрастанию
+  for (size_t i = pool->capacity; i < capacity; i++) {
+    pool->generations[i] = pool->first_generation;
+    pool_push_free(pool, (uint32_t)i);
+  }
+  pool->capacity = capacity;
+  return true;
+}
+
+static void *pool_alloc(Pool *pool, uint32_t *slot) {
+  if (pool->free_head == POOL_NONE && !pool_grow(pool, 0)) {
+    return NULL;
+  }
+  *slot = pool->free_head;
+  pool->free_head = pool->next_free[*slot];
+  if (pool->free_head == POOL_NONE) {
+    pool->free_tail = POOL_NONE;
+  }
+  pool->next_free[*slot] = POOL_USED;
+  pool->count++;
+
+  void *item = pool_at(pool, *slot);
+  memset(item, 0, pool->item_size);
+  return item;
+}
+
+static void pool_release(Pool *pool, uint32_t slot) {
+  pool->count--;
+  if (pool->generations[slot] == POOL_GENERATION_MAX) {
+    pool->next_free[slot] = POOL_RETIRED;
+    return;
+  }
+  pool->generations[slot]++;
+  pool_push_free(pool, slot);
+}
+
+// Восстановление: запись занимает слот и поколение из сохранённого id.
+// Занятый слот мог стоять в очереди свободных, и pool_push_free записал
+// бы ссылку поверх его метки POOL_USED - поэтому очередь сбрасывается.
+// После восстановления её перестраивает pool_rebuild_free, поднимая
+// поколения свободных слотов и будущих кусков выше issued.
+static void *pool_claim(Pool *pool, uint32_t slot, uint32_t generation) {
+  if (pool->capacity <= slot && !pool_grow(pool, (size_t)slot + 1)) {
+    return NULL;
+  }
+  if (pool->next_free[slot] == POOL_USED) {
+    return NULL;
+  }
+  pool->generations[slot] = generation;
+  pool->next_free[slot] = POOL_USED;
+  pool->free_head = POOL_NONE;
+  pool->free_tail = POOL_NONE;
+  pool->count++;
+
+  void *item = pool_at(pool, slot);
+  memset(item, 0, pool->item_size);
+  return item;
+}
+
+static void pool_rebuild_free(Pool *pool, uint32_t issued) {
+  for (size_t i = 0; i < pool->capacity; i++) {
+    if (pool->next_free[i] == POOL_USED && pool->generations[i] > issued) {
+      issued = pool->generations[i];
+    }
+  }
+  // Поколения не переходят через ноль: если выданы все, свободные слоты
+  // выводятся и пул больше не растёт
+  if (issued > POOL_GENERATION_MAX) {
+    issued = POOL_GENERATION_MAX;
+  }
+  pool->first_generation = issued + 1;
+
+  pool->free_head = POOL_NONE;
+  pool->free_tail = POOL_NONE;
+  for (size_t i = 0; i < pool->capacity; i++) {
+    if (pool->next_free[i] == POOL_USED) {
+      continue;
+    }
+    if (pool->first_generation > POOL_GENERATION_MAX) {
+      pool->next_free[i] = POOL_RETIRED;
+    } else {
+      pool->generations[i] = pool->first_generation;
+      pool_push_free(pool, (uint32_t)i);
+    }
+  }
+}
+
+static int64_t pool_id(const Pool *pool, uint32_t slot) {
+  return (int64_t)((uint64_t)pool->generations[slot] << POOL_SLOT_BITS | slot);
+}
+
+static bool match_login(const void *item, const void *key) {
+  return strcmp(((const Player *)item)->login, (const char *)key) == 0;
+}
+
+static bool match_name(const void *item, const void *key) {
+  return strcmp(((const Game *)item)->name, (const char *)key) == 0;
+}
+
+// Таблица не меньше capacity слотов, растёт вдвое
+static bool table_reserve(SlotTable *table, size_t capacity) {
+  if (capacity <= table->size) {
+    return true;
+  }
+  size_t size = table->size ? table->size : POOL_SLAB_SIZE;
+  while (size < capacity) {
+    size *= 2;
+  }
+  void **items = realloc(table->items, size * sizeof(void *));
+  if (items == NULL) {
+    return false;
+  }
+  memset(items + table->size, 0, (size - table->size) * sizeof(void *));
+  table->items = items;
+  table->size = size;
+  return true;
+}
+
+static bool table_put(SlotTable *table, int64_t id, void *item) {
+  size_t slot = POOL_SLOT(id);
+  if (!table_reserve(table, slot + 1)) {
+    return false;
+  }
+  table->items[slot] = item;
+  return true;
+}
+
+static void table_free(SlotTable *table) {
+  free(table->items);
+  table->items = NULL;
+  table->size = 0;
+}
+
+bool registry_init(Registry *reg, size_t players, size_t games) {
+  memset(reg, 0, sizeof(*reg));
+  pool_init(&reg->players, sizeof(Player));
+  pool_init(&reg->games, sizeof(Game));
+
+  bool ok = index_init(&reg->by_login, players);
+  ok = index_init(&reg->by_name, games) && ok;
+  ok = ok && registry_reserve(reg, players, games);
+  if (!ok) {
+    registry_free(reg);
+  }
+  return ok;
+}
+
+bool registry_reserve(Registry *reg, size_t players, size_t games) {
+  bool ok = reg->players.capacity >= players ||
+            pool_grow(&reg->players, players);
+  ok = ok && (reg->games.capacity >= games || pool_grow(&reg->games, games));
+  return ok && index_reserve(&reg->by_login, players) &&
+         index_reserve(&reg->by_name, games) &&
+         table_reserve(&reg->by_id, games);
+}
+
+void registry_free(Registry *reg) {
+  index_free(&reg->by_login);
+  index_free(&reg->by_name);
+  table_free(&reg->by_id);
+  pool_free_all(&reg->players);
+  pool_free_all(&reg->games);
+}
+
+Player *registry_find_player(Registry *reg, const char *login) {
+  long pos = index_find(&reg->by_login, hash_string(login), match_login, login);
+  return pos < 0 ? NULL : reg->by_login.items[pos];
+}
+
+Game *registry_find_game_by_name(Registry *reg, const char *name) {
+  long pos = index_find(&reg->by_name, hash_string(name), match_name, name);
+  return pos < 0 ? NULL : reg->by_name.items[pos];
+}
+
+// Свободная запись хранит id 0 (registry_remove_player), поэтому хватает
+// сравнения id в самой записи - без обращения к списку свободных
+Player *registry_find_player_by_id(Registry *reg, int64_t id) {
+  uint32_t slot = POOL_SLOT(id);
+  if (id <= 0 || slot >= reg->players.capacity) {
+    return NULL;
+  }
+  Player *p = pool_at(&reg->players, slot);
+  return p->id == id ? p : NULL;
+}
+
+Game *registry_find_game_by_id(Registry *reg, int64_t id) {
+  uint32_t slot = POOL_SLOT(id);
+  if (id <= 0 || slot >= reg->by_id.size) {
+    return NULL;
+  }
+  Game *game = reg->by_id.items[slot];
+  return game != NULL && game->id == id ? game : NULL;
+}
+
+// Заполнение записи, уже взятой из пула, и индекс логинов
+static Player *init_player(Registry *reg, Player *p, uint32_t slot,
+                           const char *login, const char *identity) {
+  p->slot = slot;
+  p->id = pool_id(&reg->players, slot);
+  strncpy(p->login, login, MAX_PLAYER_NAME - 1);
+  strncpy(p->identity, identity, sizeof(p->identity) - 1);
+  p->identity_len = strnlen(p->identity, sizeof(p->identity));
+  p->in_game = false;
+  p->ready = false;
+  p->bot = false;
+  p->game_id = -1;
+
+  if (!index_insert(&reg->by_login, hash_string(p->login), p)) {
+    pool_release(&reg->players, slot);
+    return NULL;
+  }
+  return p;
+}
+
+Player *registry_add_player(Registry *reg, const char *login,
+                            const char *identity) {
+  uint32_t slot;
+  Player *p = pool_alloc(&reg->players, &slot);
+  return p ? init_player(reg, p, slot, login, identity) : NULL;
+}
+
+Player *registry_restore_player(Registry *reg, int64_t id,
+                                const char *login, const char *identity) {
+  uint32_t slot = POOL_SLOT(id);
+  uint32_t generation = POOL_GENERATION(id);
+  if (id <= 0 || generation == 0 || slot >= POOL_MAX_SLOTS) {
+    return NULL;
+  }
+
+  Player *p = pool_claim(&reg->players, slot, generation);
+  return p ? init_player(reg, p, slot, login, identity) : NULL;
+}
+
+void registry_update_identity(Player *player, const char *identity,
+                              size_t len) {
+  if (len == player->identity_len &&
+      memcmp(player->identity, identity, len) == 0) {
+    return;
+  }
+  if (len > sizeof(player->identity) - 1) {
+    len = sizeof(player->identity) - 1;
+  }
+  memcpy(player->identity, identity, len);
+  player->identity[len] = '\0';
+  player->identity_len = len;
+}
+
+// Игрок не должен состоять в игре: игры держат указатели на игроков
+void registry_remove_player(Registry *reg, Player *player) {
+  index_remove(&reg->by_login, hash_string(player->login), match_login,
+               player->login);
+  player->id = 0;
+  pool_release(&reg->players, player->slot);
+}
+
+// Заполнение записи, уже взятой из пула, и индексы
+static Game *init_game(Registry *reg, Game *game, uint32_t slot,
+                       int64_t id, const char *name, Player *creator) {
+  game->slot = slot;
+  game->id = id;
+  strncpy(game->name, name, MAX_GAME_NAME - 1);
+  strncpy(game->players[0], creator->login, MAX_PLAYER_NAME - 1);
+  game->player_refs[0] = creator;
+  game->player_count = 1;
+  game->status = GAME_WAITING;
+  game->current_turn = rand() % 2;
+
+  if (!index_insert(&reg->by_name, hash_string(game->name), game)) {
+    pool_release(&reg->games, slot);
+    return NULL;
+  }
+  if (!table_put(&reg->by_id, game->id, game)) {
+    index_remove(&reg->by_name, hash_string(game->name), match_name,
+                 game->name);
+    pool_release(&reg->games, slot);
+    return NULL;
+  }
+
+  creator->game_id = game->id;
+  creator->in_game = true;
+  return game;
+}
+
+// id > 0 - id выдан снаружи (воркеру его передаёт лобби)
+static Game *add_game(Registry *reg, int64_t id, const char *name,
+                      Player *creator) {
+  uint32_t slot;
+  Game *game = pool_alloc(&reg->games, &slot);
+  if (game == NULL) {
+    return NULL;
+  }
+  return init_game(reg, game, slot, id > 0 ? id : pool_id(&reg->games, slot),
+                   name, creator);
+}
+
+Game *registry_create_game(Registry *reg, const char *name, Player *creator) {
+  return add_game(reg, 0, name, creator);
+}
+
+// Для воркеров: id игры выдаёт лобби
+Game *registry_create_game_with_id(Registry *reg, int64_t id,
+                                   const char *name, Player *creator) {
+  return id > 0 ? add_game(reg, id, name, creator) : NULL;
+}
+
+Game *registry_restore_game(Registry *reg, int64_t id, const char *name,
+                            Player *creator) {
+  uint32_t slot = POOL_SLOT(id);
+  uint32_t generation = POOL_GENERATION(id);
+  if (id <= 0 || generation == 0 || slot >= POOL_MAX_SLOTS) {
+    return NULL;
+  }
+
+  Game *game = pool_claim(&reg->games, slot, generation);
+  if (game == NULL) {
+    return NULL;
+  }
+  return init_game(reg, game, slot, id, name, creator);
+}
+
+void registry_restore_done(Registry *reg, uint32_t player_generation,
+                           uint32_t game_generation) {
+  pool_rebuild_free(&reg->players, player_generation);
+  pool_rebuild_free(&reg->games, game_generation);
+}
+
+bool registry_join_game(Registry *reg, Game *game, Player *player) {
+  (void)reg;
+  if (game->player_count >= MAX_PLAYERS) {
+    return false;
+  }
+
+  strncpy(game->players[game->player_count], player->login,
+          MAX_PLAYER_NAME - 1);
+  game->players[game->player_count][MAX_PLAYER_NAME - 1] = '\0';
+  game->player_refs[game->player_count] = player;
+  game->player_count++;
+
+  if (game->player_count == MAX_PLAYERS) {
+    game->status = GAME_PLACING_SHIPS;
+  }
+
+  player->game_id = game->id;
+  player->in_game = true;
+  return true;
+}
+
+void registry_finish_game(Registry *reg, Game *game) {
+  game->status = GAME_FINISHED;
+
+  index_remove(&reg->by_name, hash_string(game->name), match_name, game->name);
+  Game **entry = (Game **)&reg->by_id.items[POOL_SLOT(game->id)];
+  if (*entry == game) {
+    *entry = NULL;
+  }
+
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p != NULL) {
+      p->in_game = false;
+      p->game_id = -1;
+      p->ready = false;
+    }
+  }
+
+  pool_release(&reg->games, game->slot);
+}
+
+Game *registry_next_game(Registry *reg, size_t *cursor) {
+  while (*cursor < reg->games.capacity) {
+    uint32_t slot = (uint32_t)(*cursor)++;
+    if (reg->games.next_free[slot] == POOL_USED) {
+      return pool_at(&reg->games, slot);
+    }
+  }
+  return NULL;
+}
+
+Player *registry_next_player(Registry *reg, size_t *cursor) {
+  while (*cursor < reg->players.capacity) {
+    uint32_t slot = (uint32_t)(*cursor)++;
+    if (reg->players.next_free[slot] == POOL_USED) {
+      return pool_at(&reg->players, slot);
+    }
+  }
+  return NULL;
+}
+
+int game_player_index(const Game *game, const Player *player) {
+  for (int i = 0; i < game->player_count; i++) {
+    if (game->player_refs[i] == player) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool game_list_append(GameList *list, Game *game, uint32_t seq) {
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 64;
+    GameListEntry *items =
+        realloc(list->items, capacity * sizeof(GameListEntry));
+    if (items == NULL) {
+      return false;
+    }
+    list->items = items;
+    list->capacity = capacity;
+  }
+  list->items[list->count++] = (GameListEntry){seq, game};
+  list->live++;
+  return true;
+}
+
+// Убирает удалённые записи, порядок сохраняется
+static void game_list_compact(GameList *list) {
+  size_t out = 0;
+  for (size_t i = 0; i < list->count; i++) {
+    if (list->items[i].game != NULL) {
+      list->items[out++] = list->items[i];
+    }
+  }
+  list->count = out;
+}
+
+size_t game_list_seek(const GameList *list, uint32_t after) {
+  size_t lo = 0, hi = list->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (list->items[mid].seq <= after) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void game_list_remove(GameList *list, uint32_t seq) {
+  size_t i = game_list_seek(list, seq - 1);
+  if (i >= list->count || list->items[i].seq != seq ||
+      list->items[i].game == NULL) {
+    return;
+  }
+  list->items[i].game = NULL;
+  list->live--;
+  if (list->live * 2 < list->count) {
+    game_list_compact(list);
+  }
+}
+
+void game_list_free(GameList *list) {
+  free(list->items);
+  memset(list, 0, sizeof(*list));
+}
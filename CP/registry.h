@@ -0,0 +1,137 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "common.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Хэш-индекс с открытой адресацией (линейное пробирование).
+// Хранит указатели на записи, сами ключи лежат в записях.
+// Растёт вдвое, когда заполнение превышает 50%.
+typedef struct {
+  uint32_t *hashes; // 0 - пустой слот
+  void **items;
+  size_t mask;
+  size_t count;
+} HashIndex;
+
+#define POOL_SLAB_SIZE 256
+#define POOL_MAX_SLOTS (1u << 22) // до 4M записей
+// id записи - int64_t: поколение << POOL_SLOT_BITS | слот
+#define POOL_SLOT_BITS 32
+#define POOL_GENERATION_MAX INT32_MAX // id остаётся положительным
+#define POOL_SLOT(id) ((uint32_t)(uint64_t)(id))
+#define POOL_GENERATION(id) ((uint32_t)((uint64_t)(id) >> POOL_SLOT_BITS))
+
+// Пул записей фиксированного размера. Записи лежат в кусках (slab) по
+// POOL_SLAB_SIZE и никогда не переезжают, поэтому на них можно держать
+// указатели. Освобождённые слоты встают в конец очереди свободных, а
+// поколение слота увеличивается: id записи (слот + поколение) не
+// повторяется и устаревшая ссылка не находит новую запись. Очередь
+// выдаёт слоты по кругу, так что поколения растут равномерно; слот,
+// исчерпавший поколения, больше не выдаётся.
+typedef struct {
+  size_t item_size;
+  char **slabs;
+  size_t slab_count;
+  char **blocks; // Память кусков: один блок на каждый рост пула
+  size_t block_count;
+  uint32_t *generations;
+  uint32_t *next_free; // POOL_USED - слот занят, POOL_RETIRED - выведен
+  uint32_t free_head;
+  uint32_t free_tail;
+  uint32_t first_generation; // поколение слотов новых кусков
+  size_t capacity;
+  size_t count;
+} Pool;
+
+// Записи по слоту из id (POOL_SLOT), запись проверяется по
+// полному id. У лобби слот id - это слот пула; воркер хранит игры лобби
+// в своём пуле, и его таблица разреженная, но поиск всё равно одно
+// обращение без хэширования.
+typedef struct {
+  void **items;
+  size_t size;
+} SlotTable;
+
+// Реестр игроков и игр сервера
+typedef struct {
+  Pool players;
+  Pool games;
+
+  HashIndex by_login; // Player* по логину
+  HashIndex by_name;  // Game* по имени (только незавершённые игры)
+  SlotTable by_id;    // Game* по слоту id
+} Registry;
+
+// Размеры - начальная ёмкость, дальше реестр растёт сам
+bool registry_init(Registry *reg, size_t players, size_t games);
+// Заранее растит реестр, например перед восстановлением состояния
+bool registry_reserve(Registry *reg, size_t players, size_t games);
+void registry_free(Registry *reg);
+
+Player *registry_find_player(Registry *reg, const char *login);
+// По id записи (дескриптор сессии): слот пула и проверка поколения
+Player *registry_find_player_by_id(Registry *reg, int64_t id);
+Game *registry_find_game_by_name(Registry *reg, const char *name);
+Game *registry_find_game_by_id(Registry *reg, int64_t id);
+
+// NULL только при нехватке памяти
+Player *registry_add_player(Registry *reg, const char *login,
+                            const char *identity);
+void registry_remove_player(Registry *reg, Player *player);
+// identity меняется только при переподключении: сначала сравнение с
+// сохранённой длиной и байтами, запись - лишь если изменилась
+void registry_update_identity(Player *player, const char *identity,
+                              size_t len);
+Game *registry_create_game(Registry *reg, const char *name, Player *creator);
+Game *registry_create_game_with_id(Registry *reg, int64_t id,
+                                   const char *name, Player *creator);
+// Игра с сохранённым id (лобби после перезапуска): занимает тот же слот,
+// чтобы новые id не совпали с восстановленными. После серии вызовов -
+// registry_restore_done, до неё создавать игры обычным способом нельзя.
+Game *registry_restore_game(Registry *reg, int64_t id, const char *name,
+                            Player *creator);
+// То же для игрока: id - его дескриптор сессии, он переживает перезапуск
+Player *registry_restore_player(Registry *reg, int64_t id,
+                                const char *login, const char *identity);
+// player_generation и game_generation - старшие поколения id, выданных
+// до перезапуска. Свободные слоты и куски, добавленные позже, начинают
+// выше них и выше восстановленных записей, так что id, освобождённые до
+// перезапуска, не достанутся новым игрокам и играм.
+void registry_restore_done(Registry *reg, uint32_t player_generation,
+                           uint32_t game_generation);
+bool registry_join_game(Registry *reg, Game *game, Player *player);
+// Освобождает игроков и слот игры, после вызова game недействителен
+void registry_finish_game(Registry *reg, Game *game);
+
+// Обход живых игр: *cursor начинается с 0, NULL - игр больше нет
+Game *registry_next_game(Registry *reg, size_t *cursor);
+Player *registry_next_player(Registry *reg, size_t *cursor);
+
+int game_player_index(const Game *game, const Player *player);
+
+// Список игр, упорядоченный по возрастающему номеру (seq). Удаление
+// оставляет пустую запись, список уплотняется, когда пустых больше
+// половины. Номер - курсор для постраничного обхода: продолжение с
+// первой записи, чей номер больше курсора, без пересчёта всех игр.
+typedef struct {
+  uint32_t seq;
+  Game *game; // NULL - игра удалена
+} GameListEntry;
+
+typedef struct {
+  GameListEntry *items;
+  size_t count; // вместе с удалёнными
+  size_t live;
+  size_t capacity;
+} GameList;
+
+// seq должен быть больше номеров всех игр, добавленных раньше
+bool game_list_append(GameList *list, Game *game, uint32_t seq);
+void game_list_remove(GameList *list, uint32_t seq);
+// Позиция первой записи с номером больше after
+size_t game_list_seek(const GameList *list, uint32_t after);
+void game_list_free(GameList *list);
+
+#endif // REGISTRY_H
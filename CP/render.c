@@ -0,0 +1,220 @@
+#include "render.h"
+#include <errno.h>
+
+// Полный кадр двух досок с текстом - около 1.5 КБ
+#define FRAME_SIZE 8192
+// "%2d " с номером строки и по 3 символа на клетку
+#define BOARD_WIDTH (3 + 3 * BOARD_SIZE)
+// Доски экрана разделены " | "
+#define SCREEN_BOARD_STEP (BOARD_WIDTH + 3)
+// Строки экрана (с 1): подписи, номера столбцов, доски, пустая, текст
+#define SCREEN_TITLE_ROW 1
+#define SCREEN_BOARD_ROW 3
+#define SCREEN_TEXT_ROW (SCREEN_BOARD_ROW + BOARD_SIZE + 1)
+
+// Клиент выводит из одного потока, буфер кадра общий
+static char frame[FRAME_SIZE];
+static size_t frame_len;
+
+static void put(const char *s, size_t n) {
+  if (n > FRAME_SIZE - frame_len) {
+    n = FRAME_SIZE - frame_len;
+  }
+  memcpy(frame + frame_len, s, n);
+  frame_len += n;
+}
+
+static void put_str(const char *s) { put(s, strlen(s)); }
+
+static void put_char(char c) {
+  if (frame_len < FRAME_SIZE) {
+    frame[frame_len++] = c;
+  }
+}
+
+static void put_number(int n) {
+  char digits[8];
+  int k = 0;
+  do {
+    digits[k++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n > 0);
+  while (k > 0) {
+    put_char(digits[--k]);
+  }
+}
+
+// Номер строки или столбца: "%2d "
+static void put_label(int n) {
+  if (n < 10) {
+    put_char(' ');
+  }
+  put_number(n);
+  put_char(' ');
+}
+
+// ESC [ row ; col H - курсор в позицию (с 1)
+static void put_move(int row, int col) {
+  put_str("\033[");
+  put_number(row);
+  put_char(';');
+  put_number(col);
+  put_char('H');
+}
+
+static char cell_glyph(int cell, bool show_ships) {
+  switch (cell) {
+  case 1:
+    return show_ships ? 'S' : '.';
+  case 2:
+    return 'O';
+  case 3:
+    return 'X';
+  default:
+    return '.';
+  }
+}
+
+static void put_columns(void) {
+  put_str("   ");
+  for (int x = 0; x < BOARD_SIZE; x++) {
+    put_label(x);
+  }
+}
+
+static void put_row(int board[BOARD_SIZE][BOARD_SIZE], int y,
+                    bool show_ships) {
+  put_label(y);
+  for (int x = 0; x < BOARD_SIZE; x++) {
+    put_char(' ');
+    put_char(cell_glyph(board[y][x], show_ships));
+    put_char(' ');
+  }
+}
+
+// Сбрасывает stdio, чтобы кадр встал после уже напечатанного, и
+// отдаёт кадр одним write; повторяется только недописанный хвост
+static void flush_frame(void) {
+  fflush(stdout);
+  size_t done = 0;
+  while (done < frame_len) {
+    ssize_t n = write(STDOUT_FILENO, frame + done, frame_len - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += (size_t)n;
+  }
+  frame_len = 0;
+}
+
+void print_board(int board[BOARD_SIZE][BOARD_SIZE], bool show_ships) {
+  put_columns();
+  put_char('\n');
+  for (int y = 0; y < BOARD_SIZE; y++) {
+    put_row(board, y, show_ships);
+    put_char('\n');
+  }
+  flush_frame();
+}
+
+void print_boards_side_by_side(int my_board[BOARD_SIZE][BOARD_SIZE],
+                               int enemy_board[BOARD_SIZE][BOARD_SIZE]) {
+  put_str("      YOUR BOARD                     OPPONENT BOARD\n");
+  put_columns();
+  put_str(" |   ");
+  for (int x = 0; x < BOARD_SIZE; x++) {
+    put_label(x);
+  }
+  put_char('\n');
+
+  for (int y = 0; y < BOARD_SIZE; y++) {
+    put_row(my_board, y, true);
+    put_str(" | ");
+    put_row(enemy_board, y, false); // корабли противника скрыты
+    put_char('\n');
+  }
+  flush_frame();
+}
+
+void screen_init(Screen *screen) { memset(screen, 0, sizeof(*screen)); }
+
+// Текст в позиции (row, col), не длиннее width. Переписывается, только
+// если изменился; хвост прежнего текста затирается пробелами.
+static void screen_text(char shown[SCREEN_TEXT], const char *text, int row,
+                        int col, size_t width) {
+  if (text == NULL) {
+    text = "";
+  }
+  size_t len = strnlen(text, width);
+  size_t old = strlen(shown);
+  if (len == old && memcmp(shown, text, len) == 0) {
+    return;
+  }
+  put_move(row, col);
+  put(text, len);
+  for (size_t i = len; i < old; i++) {
+    put_char(' ');
+  }
+  memcpy(shown, text, len);
+  shown[len] = '\0';
+}
+
+void screen_draw(Screen *screen,
+                 int boards[SCREEN_BOARDS][BOARD_SIZE][BOARD_SIZE],
+                 const char *titles[SCREEN_BOARDS],
+                 const char *lines[SCREEN_LINES]) {
+  if (!screen->drawn) {
+    // Очистка экрана и доски целиком
+    put_str("\033[H\033[2J");
+    put_move(SCREEN_BOARD_ROW - 1, 1);
+    for (int k = 0; k < SCREEN_BOARDS; k++) {
+      put_str(k > 0 ? " | " : "");
+      put_columns();
+    }
+    for (int y = 0; y < BOARD_SIZE; y++) {
+      put_move(SCREEN_BOARD_ROW + y, 1);
+      for (int k = 0; k < SCREEN_BOARDS; k++) {
+        put_str(k > 0 ? " | " : "");
+        put_row(boards[k], y, false);
+        for (int x = 0; x < BOARD_SIZE; x++) {
+          screen->cells[k][y * BOARD_SIZE + x] =
+              cell_glyph(boards[k][y][x], false);
+        }
+      }
+    }
+    memset(screen->titles, 0, sizeof(screen->titles));
+    memset(screen->lines, 0, sizeof(screen->lines));
+    screen->drawn = true;
+  }
+
+  // Изменившиеся клетки: курсор на символ клетки и новый символ
+  for (int k = 0; k < SCREEN_BOARDS; k++) {
+    for (int y = 0; y < BOARD_SIZE; y++) {
+      for (int x = 0; x < BOARD_SIZE; x++) {
+        char glyph = cell_glyph(boards[k][y][x], false);
+        char *shown = &screen->cells[k][y * BOARD_SIZE + x];
+        if (*shown != glyph) {
+          put_move(SCREEN_BOARD_ROW + y, k * SCREEN_BOARD_STEP + 3 * x + 5);
+          put_char(glyph);
+          *shown = glyph;
+        }
+      }
+    }
+  }
+
+  for (int k = 0; k < SCREEN_BOARDS; k++) {
+    screen_text(screen->titles[k], titles[k], SCREEN_TITLE_ROW,
+                k * SCREEN_BOARD_STEP + 1, BOARD_WIDTH);
+  }
+  for (int i = 0; i < SCREEN_LINES; i++) {
+    screen_text(screen->lines[i], lines[i], SCREEN_TEXT_ROW + i, 1,
+                SCREEN_TEXT - 1);
+  }
+
+  // Курсор под кадр, чтобы следующий вывод не затёр доски
+  put_move(SCREEN_TEXT_ROW + SCREEN_LINES, 1);
+  flush_frame();
+}
@@ -0,0 +1,42 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "common.h"
+
+// Вывод досок клиента в терминал.
+//
+// Кадр собирается целиком в заранее выделенном буфере и уходит одним
+// write(2) вместо сотен printf по клетке. Буфер stdio перед этим
+// сбрасывается, так что порядок с остальным выводом сохраняется.
+//
+// Клетки - как в старом интерфейсе common.h: 0 - пусто, 1 - корабль,
+// 2 - промах, 3 - попадание.
+void print_board(int board[BOARD_SIZE][BOARD_SIZE], bool show_ships);
+void print_boards_side_by_side(int my_board[BOARD_SIZE][BOARD_SIZE],
+                               int enemy_board[BOARD_SIZE][BOARD_SIZE]);
+
+// Экран с перерисовкой на месте (режим зрителя). Первый кадр очищает
+// терминал и рисует доски рядом, со строками текста под ними; каждый
+// следующий переставляет курсор ANSI-последовательностями и переписывает
+// только клетки и строки, изменившиеся с прошлого кадра. Выстрел -
+// десяток байт вместо полного кадра.
+#define SCREEN_BOARDS 2
+#define SCREEN_LINES 3
+#define SCREEN_TEXT 80
+
+typedef struct {
+  bool drawn; // экран очищен, рамка нарисована
+  char titles[SCREEN_BOARDS][SCREEN_TEXT];
+  char cells[SCREEN_BOARDS][BOARD_SIZE * BOARD_SIZE]; // символы на экране
+  char lines[SCREEN_LINES][SCREEN_TEXT];
+} Screen;
+
+void screen_init(Screen *screen);
+// titles - подписи досок, lines - строки под досками (NULL - пустая).
+// Корабли не показываются.
+void screen_draw(Screen *screen,
+                 int boards[SCREEN_BOARDS][BOARD_SIZE][BOARD_SIZE],
+                 const char *titles[SCREEN_BOARDS],
+                 const char *lines[SCREEN_LINES]);
+
+#endif // RENDER_H
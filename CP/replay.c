@@ -0,0 +1,276 @@
+// Прогон архива партий (archive.h): каждая партия заново разыгрывается
+// движком common.c - флоты расставляются теми же функциями, что у
+// сервера, выстрелы идут по порядку, и результат каждого выстрела, число
+// ходов и победитель сверяются с записанными. Расхождение означает, что
+// движок стал считать иначе, чем при записи партии. Сегменты делятся
+// между потоками, каждый читает свои через mmap.
+#include "archive.h"
+#include "stats.h"
+#include "timer.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_THREADS 64
+#define MAX_SEGMENTS 4096
+#define PATH_SIZE 1024
+
+typedef struct {
+  int index;
+  uint64_t games;
+  uint64_t moves;
+  uint64_t hits;
+  uint64_t first_wins;
+  uint64_t timeouts;
+  uint64_t ticks; // суммарная длительность партий
+  uint64_t mismatches;
+  uint64_t damaged; // байт за последней целой записью сегментов
+  uint64_t bytes;
+} ReplayThread;
+
+static char *segments[MAX_SEGMENTS];
+static int segment_count;
+static int thread_count = 1;
+static bool verbose;
+
+static bool place_fleet(Board *board, const ArchiveGame *g, int player) {
+  int bad_ship;
+  if (!(g->outcome & ARCHIVE_CUSTOM_FLEET)) {
+    return board_place_fleet(board, g->ships[player], &bad_ship);
+  }
+  board_clear(board);
+  for (int i = 0; i < MAX_SHIPS; i++) {
+    int cell = g->ships[player][i] & ~FLEET_HORIZONTAL;
+    int horizontal = (g->ships[player][i] & FLEET_HORIZONTAL) ? 1 : 0;
+    if (cell >= BOARD_SIZE * BOARD_SIZE ||
+        !board_place_ship(board, cell % BOARD_SIZE, cell / BOARD_SIZE,
+                          g->sizes[player][i], horizontal)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Разыгрывает партию; NULL - совпала с записью, иначе причина расхождения
+static const char *replay_game(const ArchiveGame *g, ReplayThread *t) {
+  Board boards[MAX_PLAYERS];
+  int remaining[MAX_PLAYERS] = {MAX_SHIPS, MAX_SHIPS};
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    if (!place_fleet(&boards[i], g, i)) {
+      return "invalid fleet";
+    }
+  }
+
+  int turn = 0;
+  uint64_t hits = 0, ticks = 0;
+  for (int i = 0; i < g->move_count; i++) {
+    const ArchiveMove *m = &g->moves[i];
+    int target = 1 - turn;
+    if (remaining[target] == 0) {
+      return "shots after the last ship sunk";
+    }
+    ShotResult result = board_shot(&boards[target], m->cell % BOARD_SIZE,
+                                   m->cell / BOARD_SIZE);
+    if (result != (ShotResult)m->result) {
+      return result == SHOT_INVALID ? "invalid shot" : "shot result differs";
+    }
+    if (result == SHOT_MISS) {
+      turn = target;
+    } else {
+      hits++;
+      if (result == SHOT_SUNK) {
+        remaining[target]--;
+      }
+    }
+    ticks += m->delta;
+  }
+
+  int winner = (g->outcome & ARCHIVE_WINNER) ? 1 : 0;
+  if (g->outcome & ARCHIVE_TIMEOUT) {
+    // Срок вышел у того, чей был ход, и его флот ещё на плаву
+    if (turn == winner || remaining[0] == 0 || remaining[1] == 0) {
+      return "timeout winner differs";
+    }
+  } else if (remaining[1 - winner] != 0 || turn != winner) {
+    return "winner differs";
+  }
+
+  t->first_wins += winner == 0;
+  t->timeouts += (g->outcome & ARCHIVE_TIMEOUT) != 0;
+  t->moves += (uint64_t)g->move_count;
+  t->hits += hits;
+  t->ticks += ticks;
+  return NULL;
+}
+
+static void replay_segment(ReplayThread *t, const char *path) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+  size_t len = (size_t)st.st_size;
+  const uint8_t *data =
+      len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED || !archive_segment_valid(data, len)) {
+    fprintf(stderr, "%s: not an archive segment\n", path);
+    if (data != MAP_FAILED)
+      munmap((void *)data, len);
+    return;
+  }
+  madvise((void *)data, len, MADV_SEQUENTIAL);
+
+  static __thread ArchiveGame game;
+  size_t pos = ARCHIVE_HEADER_SIZE;
+  const uint8_t *body;
+  size_t body_len;
+  while (archive_next(data, len, &pos, &body, &body_len)) {
+    const char *why = archive_decode(body, body_len, &game)
+                          ? replay_game(&game, t)
+                          : "damaged record";
+    t->games++;
+    if (why != NULL) {
+      t->mismatches++;
+      if (verbose) {
+        printf("%s: game %lld (%s vs %s): %s\n", path,
+               (long long)game.game_id,
+               game.players[0], game.players[1], why);
+      }
+    }
+  }
+  t->damaged += len - pos;
+  t->bytes += len;
+  munmap((void *)data, len);
+}
+
+static void *replay_thread(void *arg) {
+  ReplayThread *t = arg;
+  for (int i = t->index; i < segment_count; i += thread_count) {
+    replay_segment(t, segments[i]);
+  }
+  return NULL;
+}
+
+static int compare_paths(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool add_segment(const char *path) {
+  if (segment_count == MAX_SEGMENTS) {
+    fprintf(stderr, "Too many segments, at most %d\n", MAX_SEGMENTS);
+    return false;
+  }
+  segments[segment_count++] = strdup(path);
+  return true;
+}
+
+// Каталог - все его сегменты по порядку, иначе сам файл
+static bool add_path(const char *path) {
+  DIR *d = opendir(path);
+  if (d == NULL) {
+    return add_segment(path);
+  }
+  int first = segment_count;
+  struct dirent *entry;
+  bool ok = true;
+  while (ok && (entry = readdir(d)) != NULL) {
+    unsigned seq;
+    if (sscanf(entry->d_name, "replays-%8u.bin", &seq) == 1) {
+      char full[PATH_SIZE];
+      snprintf(full, sizeof(full), "%s/%s", path, entry->d_name);
+      ok = add_segment(full);
+    }
+  }
+  closedir(d);
+  qsort(segments + first, (size_t)(segment_count - first), sizeof(char *),
+        compare_paths);
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "t:v")) != -1) {
+    switch (opt) {
+    case 't':
+      thread_count = atoi(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      optind = argc + 1;
+      break;
+    }
+  }
+  if (optind >= argc || thread_count < 1 || thread_count > MAX_THREADS) {
+    fprintf(stderr,
+            "Usage: %s [-t threads] [-v] archive_dir|segment...\n"
+            "  e.g. %s -t 4 " ARCHIVE_DEFAULT_DIR "\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+  for (int i = optind; i < argc; i++) {
+    if (!add_path(argv[i])) {
+      return 2;
+    }
+  }
+  if (segment_count == 0) {
+    fprintf(stderr, "No archive segments found\n");
+    return 2;
+  }
+
+  ReplayThread *threads = calloc((size_t)thread_count, sizeof(ReplayThread));
+  pthread_t tids[MAX_THREADS];
+  uint64_t start = stats_now_ns();
+  for (int i = 0; i < thread_count; i++) {
+    threads[i].index = i;
+    if (pthread_create(&tids[i], NULL, replay_thread, &threads[i]) != 0) {
+      fprintf(stderr, "Error starting replay thread\n");
+      return 2;
+    }
+  }
+
+  ReplayThread total = {0};
+  for (int i = 0; i < thread_count; i++) {
+    pthread_join(tids[i], NULL);
+    total.games += threads[i].games;
+    total.moves += threads[i].moves;
+    total.hits += threads[i].hits;
+    total.first_wins += threads[i].first_wins;
+    total.timeouts += threads[i].timeouts;
+    total.ticks += threads[i].ticks;
+    total.mismatches += threads[i].mismatches;
+    total.damaged += threads[i].damaged;
+    total.bytes += threads[i].bytes;
+  }
+  double seconds = (stats_now_ns() - start) / 1e9;
+
+  // Статистика - по совпавшим партиям
+  uint64_t good = total.games - total.mismatches;
+  double per_game = good ? 1.0 / (double)good : 0;
+  printf("Segments:    %d, %.1f MB (%.0f bytes per game), %llu bytes of "
+         "damaged tails\n",
+         segment_count, total.bytes / 1e6,
+         total.games ? (double)total.bytes / total.games : 0,
+         (unsigned long long)total.damaged);
+  printf("Games:       %llu, mismatches %llu\n",
+         (unsigned long long)total.games,
+         (unsigned long long)total.mismatches);
+  printf("Moves:       %.1f per game, %.1f%% hits\n", total.moves * per_game,
+         total.moves ? 100.0 * total.hits / total.moves : 0);
+  printf("Outcomes:    first player wins %.1f%%, timeouts %.1f%%\n",
+         100.0 * total.first_wins * per_game,
+         100.0 * total.timeouts * per_game);
+  printf("Game length: %.1f s on average\n",
+         total.ticks * per_game * TIMER_TICK_MS / 1000.0);
+  printf("Replayed in %.2f s: %.0f games/s, %.1f M games/min\n", seconds,
+         total.games / seconds, total.games / seconds * 60 / 1e6);
+  return total.mismatches > 0 ? 1 : 0;
+}
@@ -1,691 +1,537 @@
-#include "common.h"
+#include "server.h"
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-Player players[100];
-Game games[MAX_GAMES];
-int player_count = 0;
-int game_count = 0;
-int next_game_id = 1;
-
-int server_receive(void *socket, char *identity, Message *msg) {
-  if (zmq_recv(socket, identity, 256, 0) <= 0)
-    return 0;
-
-  zmq_recv(socket, NULL, 0, 0); // empty frame
-
-  int size = zmq_recv(socket, msg, sizeof(Message), 0);
-  return size == sizeof(Message);
-}
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  void *router;                   // клиенты или брокер (DEALER)
+  void *threads[MAX_WORKERS + 1]; // [0] - лобби, [i + 1] - воркер i
+  int worker_count;
+  ServerRole role;
+  zmq_msg_t identity; // кадры текущего сообщения
+  zmq_msg_t payload;
+  uint8_t busy[32]; // готовый ответ MSG_ERROR / ST_SERVER_BUSY
+  size_t busy_size;
+} Frontend;
 
 void server_send(void *socket, const char *identity, Message *msg) {
-  zmq_send(socket, identity, strlen(identity), ZMQ_SNDMORE);
-  zmq_send(socket, "", 0, ZMQ_SNDMORE);
-  zmq_send(socket, msg, sizeof(Message), 0);
-}
-
-Player *find_player(const char *login) {
-  for (int i = 0; i < player_count; i++) {
-    if (strcmp(players[i].login, login) == 0) {
-      return &players[i];
-    }
+  uint8_t buf[PROTO_MAX_FRAME];
+  size_t len = proto_encode(msg, buf, sizeof(buf));
+  if (len == 0)
+    return;
+  // Остальные кадры сообщения ZeroMQ принимает, если принял первый
+  if (zmq_send(socket, identity, strlen(identity),
+               ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0) {
+    metrics_unsent();
+    return;
   }
-  return NULL;
-}
+  zmq_send(socket, buf, len, ZMQ_DONTWAIT);
 
-Game *find_game_by_name(const char *name) {
-  for (int i = 0; i < game_count; i++) {
-    if (strcmp(games[i].name, name) == 0) {
-      return &games[i];
-    }
+  if (msg->type == MSG_ERROR && identity[0] != '\0') {
+    metrics_error(msg->status);
   }
-  return NULL;
 }
 
-Game *find_game_by_id(int id) {
-  for (int i = 0; i < game_count; i++) {
-    if (games[i].id == id) {
-      return &games[i];
-    }
-  }
-  return NULL;
-}
+void internal_send(void *socket, Message *msg) { server_send(socket, "", msg); }
 
-Game *create_game(const char *name, const char *creator) {
-  if (game_count >= MAX_GAMES) {
-    return NULL;
-  }
-
-  Game *game = &games[game_count];
-  game->id = next_game_id++;
-  strncpy(game->name, name, MAX_GAME_NAME - 1);
-  game->name[MAX_GAME_NAME - 1] = '\0';
-  strncpy(game->players[0], creator, MAX_PLAYER_NAME - 1);
-  game->players[0][MAX_PLAYER_NAME - 1] = '\0';
-  game->player_count = 1;
-  game->status = GAME_WAITING;
-  game->current_turn = rand() % 2;
-
-  for (int p = 0; p < MAX_PLAYERS; p++) {
-    init_board(game->boards[p]);
-    for (int i = 0; i < BOARD_SIZE; i++) {
-      for (int j = 0; j < BOARD_SIZE; j++) {
-        game->shots[p][i][j] = 0;
-      }
-    }
-    game->ships_remaining[p] = 0;
-  }
+// Короткий ответ: только тип и код статуса
+void reply_status(void *socket, const char *identity, MessageType type,
+                  StatusCode status) {
+  Message response = {0};
+  response.type = type;
+  response.status = status;
+  server_send(socket, identity, &response);
+}
 
-  game_count++;
-  return game;
+// Очередь ограничена с обеих сторон, и ни фронтенд, ни потоки не ждут
+// места в ней: иначе фронтенд, ждущий воркера, и воркер, ждущий
+// фронтенда с ответами, остановили бы сервер
+static void set_queue(void *socket) {
+  int hwm = THREAD_QUEUE;
+  zmq_setsockopt(socket, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+  zmq_setsockopt(socket, ZMQ_RCVHWM, &hwm, sizeof(hwm));
 }
 
-bool add_player_to_game(Game *game, const char *player_name) {
-  if (game->player_count >= MAX_PLAYERS) {
-    return false;
+// Поток подключается к своему inproc-адресу; реестр уже заведён в main
+static bool server_thread_setup(ServerThread *t) {
+  char endpoint[64];
+  if (t->index < 0) {
+    snprintf(endpoint, sizeof(endpoint), LOBBY_ENDPOINT);
+  } else {
+    snprintf(endpoint, sizeof(endpoint), WORKER_ENDPOINT, t->index);
   }
 
-  strncpy(game->players[game->player_count], player_name, MAX_PLAYER_NAME - 1);
-  game->players[game->player_count][MAX_PLAYER_NAME - 1] = '\0';
-  game->player_count++;
-
-  if (game->player_count == MAX_PLAYERS) {
-    game->status = GAME_PLACING_SHIPS;
+  t->socket = zmq_socket(t->context, ZMQ_PAIR);
+  set_queue(t->socket);
+  if (zmq_connect(t->socket, endpoint) != 0) {
+    fprintf(stderr, "Error connecting to %s: %s\n", endpoint,
+            zmq_strerror(errno));
+    return false;
   }
+  return timer_wheel_init(&t->timers, stats_now_ns());
+}
 
+// Кадры читаются в zmq_msg_t цикла: разбор идёт прямо из буфера
+// ZeroMQ, а копируется только identity - обработчикам нужна строка
+typedef struct {
+  ServerThread *thread;
+  ThreadDispatch dispatch;
+  zmq_msg_t identity;
+  zmq_msg_t payload;
+} ThreadLoop;
+
+static bool thread_read(void *ctx, void *socket) {
+  ThreadLoop *loop = ctx;
+  ServerThread *t = loop->thread;
+  if (zmq_msg_recv(&loop->identity, socket, ZMQ_DONTWAIT) < 0)
+    return false;
+  char identity[IDENTITY_SIZE];
+  size_t id_size = zmq_msg_size(&loop->identity);
+  if (id_size > IDENTITY_SIZE - 1)
+    id_size = IDENTITY_SIZE - 1;
+  memcpy(identity, zmq_msg_data(&loop->identity), id_size);
+  identity[id_size] = '\0';
+  t->identity_len = id_size;
+
+  Message msg;
+  int size = zmq_msg_recv(&loop->payload, socket, 0);
+  if (size <= 0 ||
+      !proto_decode(zmq_msg_data(&loop->payload), (size_t)size, &msg)) {
+    metrics_invalid(t->metrics);
+    return true;
+  }
+
+  MessageType type = msg.type;
+  uint64_t started = stats_now_ns();
+  loop->dispatch(t, identity, &msg);
+  metrics_message(t->metrics, type, stats_now_ns() - started);
+  metrics_gauges(t->metrics, t->registry.players.count,
+                 t->registry.games.count);
   return true;
 }
 
-void handle_register(void *socket, char *identity, Message *msg) {
-  if (find_player(msg->sender)) {
-    Message err = {.type = MSG_ERROR};
-    strcpy(err.data, "Already registered");
-    server_send(socket, identity, &err);
-    return;
-  }
-
-  Player *p = &players[player_count++];
-  strcpy(p->login, msg->sender);
-  strcpy(p->identity, identity);
-  p->in_game = false;
-  p->ready = false;
-  p->game_id = -1;
-
-  Message ok = {.type = MSG_ACK};
-  strcpy(ok.data, "Registered");
-  server_send(socket, identity, &ok);
+void server_thread_run(ServerThread *t, ThreadDispatch dispatch,
+                       TimerFire fire) {
+  ThreadLoop loop = {.thread = t, .dispatch = dispatch};
+  zmq_msg_init(&loop.identity);
+  zmq_msg_init(&loop.payload);
+  Reactor reactor;
+  reactor_init(&reactor, REACTOR_BATCH);
+  reactor_add_socket(&reactor, t->socket, thread_read, &loop);
+  reactor_set_timers(&reactor, &t->timers, fire, t);
+  reactor_run(&reactor);
+  zmq_msg_close(&loop.identity);
+  zmq_msg_close(&loop.payload);
 }
 
-void handle_create_game(void *socket, char *identity, Message *msg) {
-  Player *player = find_player(msg->sender);
-  if (player == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Player not registered", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
-
-  if (player->in_game) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Already in a game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
-
-  if (find_game_by_name(msg->game_name) != NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Game name already exists", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
-
-  Game *game = create_game(msg->game_name, msg->sender);
-  if (game == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Failed to create game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+static void *thread_main(void *arg) {
+  ServerThread *t = arg;
+  if (!server_thread_setup(t)) {
+    exit(1);
   }
+  return t->index < 0 ? lobby_main(t) : worker_main(t);
+}
 
-  player->game_id = game->id;
-  player->in_game = true;
-
-  Message response = {0};
-  response.type = MSG_ACK;
-  response.game_id = game->id;
-  strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-  strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-  strncpy(response.game_name, msg->game_name, MAX_GAME_NAME - 1);
-  strncpy(response.data, "Game created successfully", MAX_MESSAGE_SIZE - 1);
-  server_send(socket, identity, &response);
+static int worker_slot(Frontend *f, int64_t game_id) {
+  return 1 + (int)((uint64_t)game_id % (uint64_t)f->worker_count);
+}
 
-  printf("Game '%s' created by %s (ID: %d)\n", game->name, player->login,
-         game->id);
+// Лобби отвечает за игроков и каталог игр, партии распределены по
+// воркерам по id. Возвращает номер потока-получателя.
+static int route(Frontend *f, MessageType type, int64_t game_id) {
+  return proto_is_game_request(type) ? worker_slot(f, game_id) : 0;
 }
 
-void handle_join_game(void *socket, char *identity, Message *msg) {
-  Player *player = find_player(msg->sender);
-  if (player == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Player not registered", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+// Кадры уходят теми же zmq_msg_t, что пришли: содержимое передаётся
+// дальше без копирования и без новых выделений памяти. Места в очереди
+// не ждёт; false - очередь полна, кадры остались в сообщениях.
+static bool forward(void *socket, zmq_msg_t *identity, zmq_msg_t *payload) {
+  if (zmq_msg_send(identity, socket, ZMQ_SNDMORE | ZMQ_DONTWAIT) < 0)
+    return false;
+  zmq_msg_send(payload, socket, ZMQ_DONTWAIT);
+  return true;
+}
 
-  if (player->in_game) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Already in a game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
+// Передача потоку с учётом в его счётчике очереди. Если очередь потока
+// полна, клиент сразу получает ST_SERVER_BUSY, а не ждёт ответа.
+static void dispatch_to(Frontend *f, int slot, zmq_msg_t *identity,
+                        zmq_msg_t *payload) {
+  ThreadMetrics *m = metrics_slot(slot);
+  if (forward(f->threads[slot], identity, payload)) {
+    metric_add(&m->enqueued, 1);
     return;
   }
-
-  Game *game = find_game_by_name(msg->game_name);
-  if (game == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Game not found", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  metric_add(&m->dropped, 1);
+  if (zmq_msg_size(identity) == 0) {
+    log_warn("Thread %d queue is full, internal message dropped", slot);
+  } else if (f->busy_size > 0 &&
+             zmq_msg_send(identity, f->router, ZMQ_SNDMORE | ZMQ_DONTWAIT) >=
+                 0) {
+    zmq_send(f->router, f->busy, f->busy_size, ZMQ_DONTWAIT);
   }
+}
 
-  if (game->player_count >= MAX_PLAYERS) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Game is full", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+// Ответ потока, который не принял сокет клиентов (за брокером - DEALER
+// с полной очередью), учитывается у этого потока
+static void drop_reply(Frontend *f, void *socket) {
+  int slot = 0;
+  for (int i = 1; i <= f->worker_count; i++) {
+    if (f->threads[i] == socket) {
+      slot = i;
+    }
   }
+  metric_add(&metrics_slot(slot)->dropped, 1);
+}
 
-  if (!add_player_to_game(game, msg->sender)) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Failed to join game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+// Принимает [identity][payload] в сообщения фронтенда, лишние кадры
+// отбрасывает. false - очередь пуста.
+static bool frontend_recv(Frontend *f, void *socket) {
+  if (zmq_msg_recv(&f->identity, socket, ZMQ_DONTWAIT) < 0)
+    return false;
+  zmq_msg_recv(&f->payload, socket, 0);
+  // DEALER присылает кадр без пустого разделителя, REQ - с ним
+  if (zmq_msg_size(&f->payload) == 0 && zmq_msg_more(&f->payload)) {
+    zmq_msg_recv(&f->payload, socket, 0);
+  }
+  zmq_msg_t rest;
+  zmq_msg_init(&rest);
+  bool more = zmq_msg_more(&f->payload);
+  while (more && zmq_msg_recv(&rest, socket, 0) >= 0) {
+    more = zmq_msg_more(&rest);
+  }
+  zmq_msg_close(&rest);
+  return true;
+}
 
-  player->game_id = game->id;
-  player->in_game = true;
-
-  // Уведомление обоих игроков
-  for (int i = 0; i < game->player_count; i++) {
-    Player *p = find_player(game->players[i]);
-    if (p != NULL) {
-      Message response = {0};
-      response.type = MSG_ACK;
-      response.game_id = game->id;
-      strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-      strncpy(response.recipient, game->players[i], MAX_PLAYER_NAME - 1);
-      strncpy(response.game_name, game->name, MAX_GAME_NAME - 1);
-      if (i == game->player_count - 1) {
-        strncpy(response.data, "Joined game successfully. Start placing ships!",
-                MAX_MESSAGE_SIZE - 1);
-      } else {
-        snprintf(response.data, MAX_MESSAGE_SIZE,
-                 "Player %s joined the game. Start placing ships!",
-                 msg->sender);
-      }
-      server_send(socket, p->identity, &response);
-    }
-  }
+// Пустой identity приходит только от брокера: внутреннее сообщение
+// процесса другой роли - лобби каталога или воркера шарда игр. Identity
+// клиента с нулевым байтом отбрасывается: потоки отличают внутренние
+// сообщения по пустой identity и отвечают по строке.
+static bool frontend_from_client(void *ctx, void *router) {
+  Frontend *f = ctx;
+  if (!frontend_recv(f, router))
+    return false;
 
-  printf("Player %s joined game '%s' (ID: %d)\n", player->login, game->name,
-         game->id);
+  MessageType type;
+  int64_t game_id;
+  size_t id_size = zmq_msg_size(&f->identity);
+  size_t size = zmq_msg_size(&f->payload);
+  bool internal = id_size == 0 && f->role != ROLE_STANDALONE;
+  if ((!internal && !proto_client_identity(zmq_msg_data(&f->identity),
+                                           id_size)) ||
+      id_size >= IDENTITY_SIZE || size == 0 || size > PROTO_MAX_FRAME ||
+      !proto_peek(zmq_msg_data(&f->payload), size, &type, &game_id))
+    return true;
+
+  int slot = route(f, type, game_id);
+  if (internal) {
+    slot = f->role == ROLE_DIRECTORY ? 0 : worker_slot(f, game_id);
+  }
+  dispatch_to(f, slot, &f->identity, &f->payload);
+  return true;
 }
 
-void handle_invite_player(void *socket, char *identity, Message *msg) {
-  Player *inviter = find_player(msg->sender);
-  if (inviter == NULL || !inviter->in_game) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "You are not in a game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+static bool frontend_from_thread(void *ctx, void *socket) {
+  Frontend *f = ctx;
+  if (!frontend_recv(f, socket))
+    return false;
 
-  Game *game = find_game_by_id(inviter->game_id);
-  if (game == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Game not found", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  // Внутренние сообщения лобби идут воркеру партии, воркеров - лобби.
+  // За брокером второй стороны в процессе нет, её находит брокер.
+  if (zmq_msg_size(&f->identity) > 0 || f->role != ROLE_STANDALONE) {
+    if (!forward(f->router, &f->identity, &f->payload)) {
+      drop_reply(f, socket);
+    }
+    return true;
   }
-
-  Player *invitee = find_player(msg->recipient);
-  if (invitee == NULL) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Player not found", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  MessageType type;
+  int64_t game_id;
+  if (proto_peek(zmq_msg_data(&f->payload), zmq_msg_size(&f->payload), &type,
+                 &game_id)) {
+    int slot = socket == f->threads[0] ? worker_slot(f, game_id) : 0;
+    dispatch_to(f, slot, &f->identity, &f->payload);
   }
+  return true;
+}
 
-  if (invitee->in_game) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Player is already in a game", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+// SIGINT/SIGTERM будят фронтенд через eventfd: из обработчика сигнала
+// можно только write
+static int shutdown_fd = -1;
 
-  // Отправка приглашения
-  Message response = {0};
-  response.type = MSG_INVITE_PLAYER;
-  strncpy(response.sender, msg->sender, MAX_PLAYER_NAME - 1);
-  strncpy(response.recipient, msg->recipient, MAX_PLAYER_NAME - 1);
-  strncpy(response.game_name, game->name, MAX_GAME_NAME - 1);
-  snprintf(response.data, MAX_MESSAGE_SIZE,
-           "You are invited to game '%s' by %s", game->name, msg->sender);
-  server_send(socket, identity, &response);
+static void on_shutdown_signal(int sig) {
+  (void)sig;
+  uint64_t one = 1;
+  ssize_t written = write(shutdown_fd, &one, sizeof(one));
+  (void)written;
+}
 
-  response.type = MSG_ACK;
-  strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-  strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-  strncpy(response.data, "Invitation sent", MAX_MESSAGE_SIZE - 1);
-  server_send(socket, identity, &response);
+static bool frontend_shutdown(void *ctx, void *socket) {
+  (void)socket;
+  uint64_t value;
+  ssize_t got = read(shutdown_fd, &value, sizeof(value));
+  (void)got;
+  reactor_stop(ctx);
+  return false;
+}
 
-  printf("Player %s invited %s to game '%s'\n", msg->sender, msg->recipient,
-         game->name);
+// Клиенты, ответы потоков и сигнал остановки - в одном цикле; за
+// пробуждение из каждого сокета уходит пачка сообщений
+static void frontend_run(Frontend *f) {
+  static Reactor reactor;
+  reactor_init(&reactor, REACTOR_BATCH);
+  zmq_msg_init(&f->identity);
+  zmq_msg_init(&f->payload);
+  Message busy = {0};
+  busy.type = MSG_ERROR;
+  busy.status = ST_SERVER_BUSY;
+  f->busy_size = proto_encode(&busy, f->busy, sizeof(f->busy));
+  reactor_add_socket(&reactor, f->router, frontend_from_client, f);
+  for (int i = 0; i <= f->worker_count; i++) {
+    reactor_add_socket(&reactor, f->threads[i], frontend_from_thread, f);
+  }
+
+  shutdown_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (shutdown_fd >= 0) {
+    reactor_add_fd(&reactor, shutdown_fd, frontend_shutdown, &reactor);
+    struct sigaction action = {0};
+    action.sa_handler = on_shutdown_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+  }
+
+  reactor_run(&reactor);
+  zmq_msg_close(&f->identity);
+  zmq_msg_close(&f->payload);
 }
 
-void handle_place_ship(void *socket, char *identity, Message *msg) {
-  Player *player = find_player(msg->sender);
-  if (player == NULL || !player->in_game) {
-    return;
+static void *bind_pair(void *context, const char *endpoint) {
+  void *socket = zmq_socket(context, ZMQ_PAIR);
+  set_queue(socket);
+  if (zmq_bind(socket, endpoint) != 0) {
+    fprintf(stderr, "Error binding %s: %s\n", endpoint, zmq_strerror(errno));
+    exit(1);
   }
+  return socket;
+}
 
-  Game *game = find_game_by_id(player->game_id);
-  if (game == NULL || game->status != GAME_PLACING_SHIPS) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Cannot place ship now", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+static int default_worker_count(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 2 ? (int)cpus - 1 : 1;
+}
 
-  // Определяем индекс игрока
-  int player_idx = -1;
-  for (int i = 0; i < game->player_count; i++) {
-    if (strcmp(game->players[i], msg->sender) == 0) {
-      player_idx = i;
-      break;
-    }
+// Снимок и журнал из каталога раскладываются по реестрам потоков
+static bool restore_state(const char *dir, ServerThread *threads,
+                          int worker_count) {
+  static Registry state;
+  if (!registry_init(&state, MAX_SERVER_PLAYERS, MAX_GAMES) ||
+      !journal_open(dir, &state)) {
+    return false;
   }
 
-  if (player_idx == -1) {
-    return;
+  Registry *workers[MAX_WORKERS];
+  for (int i = 0; i < worker_count; i++) {
+    workers[i] = &threads[i + 1].registry;
   }
-
-  // Парсим данные о корабле из msg->data (формат: "x,y,size,horizontal")
-  int x = -1, y = -1;
-  int size = 0;
-  int horizontal = 1;
-
-  if (sscanf(msg->data, "%d,%d,%d,%d", &x, &y, &size, &horizontal) < 3) {
-    // Используем значения из структуры
-    size = 1; // По умолчаниюs
+  if (!journal_restore(&state, &threads[0].registry, workers, worker_count)) {
+    fprintf(stderr, "Error restoring server state\n");
+    return false;
   }
+  return journal_start();
+}
 
-  if (place_ship(game->boards[player_idx], x, y, size, horizontal)) {
-    game->ships_remaining[player_idx]++;
-    printf("Player %s has placed %d ships\n", player->login,
-           game->ships_remaining[player_idx]);
-
-    if (game->ships_remaining[player_idx] == MAX_SHIPS) {
-      player->ready = true;
-      printf("Player %s is ready\n", player->login);
-    }
-
-    Message response = {0};
-    response.type = MSG_ACK;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Ship placed successfully", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-
+static bool parse_role(const char *name, ServerRole *role) {
+  if (strcmp(name, "directory") == 0) {
+    *role = ROLE_DIRECTORY;
+  } else if (strcmp(name, "games") == 0) {
+    *role = ROLE_GAMES;
   } else {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Invalid ship placement", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
+    return false;
   }
+  return true;
 }
 
-void handle_game_state(void *socket, char *identity, Message *msg) {
-  printf("handling game state req\n");
-
-  Player *player = find_player(msg->sender);
-  if (player == NULL || !player->in_game) {
-    return;
-  }
-
-  Game *game = find_game_by_id(player->game_id);
-  if (game == NULL) {
-    return;
-  }
-  // Проверяем, готовы ли оба игрока
-  bool both_ready = true;
-  for (int i = 0; i < game->player_count; i++) {
-    Player *p = find_player(game->players[i]);
-    if (p != NULL && !p->ready) {
-      both_ready = false;
+int main(int argc, char *argv[]) {
+  int worker_count = default_worker_count();
+  const char *journal_dir = JOURNAL_DEFAULT_DIR;
+  const char *archive_dir = ARCHIVE_DEFAULT_DIR;
+  int turn_limit = DEFAULT_TURN_LIMIT;
+  int idle_limit = DEFAULT_IDLE_LIMIT;
+  int port = atoi(SERVER_PORT);
+  ServerRole role = ROLE_STANDALONE;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:j:na:At:i:p:r:")) != -1) {
+    switch (opt) {
+    case 'w':
+      worker_count = atoi(optarg);
       break;
+    case 'j':
+      journal_dir = optarg;
+      break;
+    case 'n':
+      journal_dir = NULL;
+      break;
+    case 'a':
+      archive_dir = optarg;
+      break;
+    case 'A':
+      archive_dir = NULL;
+      break;
+    case 't':
+      turn_limit = atoi(optarg);
+      break;
+    case 'i':
+      idle_limit = atoi(optarg);
+      break;
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'r':
+      if (!parse_role(optarg, &role)) {
+        fprintf(stderr, "Role must be directory or games\n");
+        return 1;
+      }
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-w workers] [-j journal_dir | -n] "
+              "[-a archive_dir | -A] "
+              "[-t turn_seconds] [-i idle_seconds] [-p port] "
+              "[-r directory|games]\n",
+              argv[0]);
+      return 1;
     }
   }
-
-  Message response = {0};
-
-  if (both_ready && game->player_count == MAX_PLAYERS) {
-    game->status = GAME_PLAYING;
-    game->current_turn = 0;
-
-    // for (int i = 0; i < MAX_PLAYERS; i++) {
-    //   Player *p = find_player(game->players[i]);
-    //   if (p != NULL) {
-    //     response.type = MSG_GAME_STATE;
-    //     strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    //     strncpy(response.recipient, game->players[i], MAX_PLAYER_NAME - 1);
-    //     if (i == game->current_turn) {
-    //       strncpy(response.data, "Your turn!", MAX_MESSAGE_SIZE - 1);
-    //       printf("%s's turn\n", game->players[i]);
-    //     } else {
-    //       strncpy(response.data, "Opponent's turn", MAX_MESSAGE_SIZE - 1);
-    //     }
-    //     send_message(p->socket, &response);
-    //   }
-    // }
-
-    response.type = MSG_GAME_STATE;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, player->login, MAX_PLAYER_NAME - 1);
-    if (strcmp(player->login, game->players[game->current_turn]) == 0) {
-      strncpy(response.data, "Your turn!", MAX_MESSAGE_SIZE - 1);
-      printf("%s's turn\n", game->players[game->current_turn]);
-    } else {
-      strncpy(response.data, "Opponent's turn", MAX_MESSAGE_SIZE - 1);
-    }
-    server_send(socket, identity, &response);
-  }
-
-  else {
-    response.type = MSG_GAME_STATE;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, player->login, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Opponent is getting ready...",
-            MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
+  if (port <= 0 || port + SPECTATOR_PORT_OFFSET > 65535) {
+    fprintf(stderr, "Invalid port %d\n", port);
+    return 1;
   }
-}
-
-void handle_make_shot(void *socket, char *identity, Message *msg) {
-  Player *player = find_player(msg->sender);
-  if (player == NULL || !player->in_game) {
-    return;
+  if (turn_limit < TURN_LIMIT_MIN || turn_limit > TURN_LIMIT_MAX ||
+      idle_limit < 1) {
+    fprintf(stderr, "Turn limit must be in %d..%d s, idle limit positive\n",
+            TURN_LIMIT_MIN, TURN_LIMIT_MAX);
+    return 1;
   }
-
-  Game *game = find_game_by_id(player->game_id);
-  if (game == NULL || game->status != GAME_PLAYING) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Cannot make shot now", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  if (worker_count < 1 || worker_count > MAX_WORKERS) {
+    fprintf(stderr, "Worker count must be in 1..%d\n", MAX_WORKERS);
+    return 1;
   }
 
-  int player_idx = -1;
-  for (int i = 0; i < game->player_count; i++) {
-    if (strcmp(game->players[i], msg->sender) == 0) {
-      player_idx = i;
-      break;
-    }
+  if (!log_start()) {
+    fprintf(stderr, "Error starting log thread\n");
+    return 1;
   }
 
-  if (player_idx == -1 || player_idx != game->current_turn) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Not your turn", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  // Каталогу воркеры не нужны: реестр одного принимает партии из журнала
+  if (role == ROLE_DIRECTORY) {
+    worker_count = 1;
   }
 
-  int opponent_idx = 1 - player_idx;
-  int x = msg->x;
-  int y = msg->y;
+  void *context = zmq_ctx_new();
+  Frontend frontend = {0};
+  frontend.router =
+      zmq_socket(context, role == ROLE_STANDALONE ? ZMQ_ROUTER : ZMQ_DEALER);
+  frontend.worker_count = worker_count;
+  frontend.role = role;
 
-  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Invalid coordinates", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
-  }
+  char address[100];
+  snprintf(address, sizeof(address), "tcp://*:%d", port);
 
-  if (game->shots[player_idx][x][y] != 0) {
-    Message response = {0};
-    response.type = MSG_ERROR;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-    strncpy(response.data, "Already shot here", MAX_MESSAGE_SIZE - 1);
-    server_send(socket, identity, &response);
-    return;
+  if (zmq_bind(frontend.router, address) != 0) {
+    fprintf(stderr, "Error binding socket: %s\n", zmq_strerror(errno));
+    return 1;
   }
 
-  ShotResult result =
-      make_shot(game->boards[opponent_idx], game->shots[player_idx], x, y);
-
-  Message response = {0};
-  response.type = MSG_SHOT_RESULT;
-  response.x = x;
-  response.y = y;
-  response.shot_result = result;
-  strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-  strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-
-  if (result == SHOT_MISS) {
-    strncpy(response.data, "Miss!", MAX_MESSAGE_SIZE - 1);
-    game->current_turn = opponent_idx;
-  } else if (result == SHOT_HIT) {
-    strncpy(response.data, "Hit!", MAX_MESSAGE_SIZE - 1);
-  } else if (result == SHOT_SUNK) {
-    strncpy(response.data, "Ship sunk!", MAX_MESSAGE_SIZE - 1);
-    game->ships_remaining[opponent_idx]--;
+  // inproc: bind до того, как потоки сделают connect
+  frontend.threads[0] = bind_pair(context, LOBBY_ENDPOINT);
+  for (int i = 0; i < worker_count; i++) {
+    char endpoint[64];
+    snprintf(endpoint, sizeof(endpoint), WORKER_ENDPOINT, i);
+    frontend.threads[i + 1] = bind_pair(context, endpoint);
   }
 
-  server_send(socket, identity, &response);
-
-  Player *opponent = find_player(game->players[opponent_idx]);
-  if (opponent != NULL) {
-    Message response = {0};
-    response.type = MSG_SHOT_RESULT;
-    response.x = x;
-    response.y = y;
-    response.shot_result = result;
-    strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-    strncpy(response.recipient, game->players[opponent_idx],
-            MAX_PLAYER_NAME - 1);
-
-    if (result == SHOT_MISS) {
-      strncpy(response.data, "Opponent missed", MAX_MESSAGE_SIZE - 1);
-    } else {
-      snprintf(response.data, MAX_MESSAGE_SIZE, "Opponent hit at (%d,%d)", x,
-               y);
-    }
+  char metrics_endpoint[64];
+  char spectator_endpoint[64];
+  snprintf(metrics_endpoint, sizeof(metrics_endpoint), "tcp://*:%d",
+           port + METRICS_PORT_OFFSET);
+  snprintf(spectator_endpoint, sizeof(spectator_endpoint), "tcp://*:%d",
+           port + SPECTATOR_PORT_OFFSET);
 
-    server_send(socket, opponent->identity, &response);
+  if (!metrics_init(worker_count, metrics_endpoint)) {
+    fprintf(stderr, "Error allocating metrics\n");
+    return 1;
   }
-
-  if (check_game_over(game->boards[opponent_idx])) {
-    game->status = GAME_FINISHED;
-
-    for (int i = 0; i < game->player_count; i++) {
-      Player *p = find_player(game->players[i]);
-      if (p != NULL) {
-        Message game_over = {0};
-        game_over.type = MSG_GAME_OVER;
-        strncpy(game_over.sender, "SERVER", MAX_PLAYER_NAME - 1);
-        strncpy(game_over.recipient, game->players[i], MAX_PLAYER_NAME - 1);
-
-        if (i == player_idx) {
-          strncpy(game_over.data, "You won!", MAX_MESSAGE_SIZE - 1);
-        } else {
-          strncpy(game_over.data, "You lost!", MAX_MESSAGE_SIZE - 1);
-        }
-
-        server_send(socket, p->identity, &response);
-
-        p->in_game = false;
-        p->game_id = -1;
-        p->ready = false;
-      }
-    }
-
-    printf("Game '%s' finished. Winner: %s\n", game->name,
-           game->players[player_idx]);
+  pthread_t metrics_tid;
+  if (pthread_create(&metrics_tid, NULL, metrics_main, context) != 0) {
+    fprintf(stderr, "Error starting metrics thread\n");
+    return 1;
   }
-}
+  pthread_detach(metrics_tid);
 
-// Обработка списка игр
-void handle_list_games(void *socket, char *identity, Message *msg) {
-  Player *player = find_player(msg->sender);
-  if (player == NULL) {
-    return;
+  if (!spectator_start(context, spectator_endpoint)) {
+    fprintf(stderr, "Error starting spectator thread\n");
+    return 1;
   }
 
-  char list[MAX_MESSAGE_SIZE] = "Available games:\n";
-  int count = 0;
-
-  for (int i = 0; i < game_count; i++) {
-    if (games[i].status == GAME_WAITING ||
-        games[i].status == GAME_PLACING_SHIPS) {
-      char game_info[200];
-      snprintf(game_info, sizeof(game_info), "%d. %s (%d/%d players)\n",
-               games[i].id, games[i].name, games[i].player_count, MAX_PLAYERS);
-      if (strlen(list) + strlen(game_info) < MAX_MESSAGE_SIZE) {
-        strcat(list, game_info);
-        count++;
-      }
+  static ServerThread threads[MAX_WORKERS + 1];
+  for (int i = 0; i <= worker_count; i++) {
+    threads[i].index = i - 1; // threads[0] - лобби
+    threads[i].context = context;
+    threads[i].metrics = metrics_slot(i);
+    threads[i].turn_limit = (uint32_t)turn_limit;
+    threads[i].idle_limit = (uint32_t)idle_limit;
+    threads[i].sharded = role != ROLE_STANDALONE;
+    // Боты разных воркеров и шардов не должны играть одинаково
+    uint32_t seed = (uint32_t)time(NULL) ^ (uint32_t)getpid() << 16;
+    threads[i].bot_rng = (seed ^ (uint32_t)i * 0x9E3779B9u) | 1;
+    if (!registry_init(&threads[i].registry, MAX_SERVER_PLAYERS, MAX_GAMES)) {
+      fprintf(stderr, "Error allocating server state\n");
+      return 1;
     }
   }
-
-  if (count == 0) {
-    strncpy(list, "No available games", MAX_MESSAGE_SIZE - 1);
+  if (journal_dir != NULL &&
+      !restore_state(journal_dir, threads, worker_count)) {
+    return 1;
   }
-
-  Message response = {0};
-  response.type = MSG_LIST_GAMES;
-  strncpy(response.sender, "SERVER", MAX_PLAYER_NAME - 1);
-  strncpy(response.recipient, msg->sender, MAX_PLAYER_NAME - 1);
-  strncpy(response.data, list, MAX_MESSAGE_SIZE - 1);
-  server_send(socket, identity, &response);
-}
-
-int main() {
-  void *context = zmq_ctx_new();
-  void *socket = zmq_socket(context, ZMQ_ROUTER);
-  // void *socket = zmq_socket(context, ZMQ_ROUTER);
-
-  char address[100];
-  snprintf(address, sizeof(address), "tcp://*:%s", SERVER_PORT);
-
-  if (zmq_bind(socket, address) != 0) {
-    fprintf(stderr, "Error binding socket: %s\n", zmq_strerror(errno));
+  // Партии ведут только воркеры: каталогу архив не нужен
+  if (archive_dir != NULL && role != ROLE_DIRECTORY &&
+      (!archive_open(archive_dir) || !archive_start())) {
+    fprintf(stderr, "Error starting game archive\n");
     return 1;
   }
 
-  printf("Sea Battle server started on port %s\n", SERVER_PORT);
-  printf("Waiting for clients...\n");
-
-  while (1) {
-    char identity[256] = {0};
-    Message msg = {0};
-
-    if (!server_receive(socket, identity, &msg))
-      continue;
-
-    Player *p = find_player(msg.sender);
-
-    // если уже зарегистрирован — обновим identity (reconnect)
-    if (p) {
-      strcpy(p->identity, identity);
-    }
-
-    switch (msg.type) {
-    case MSG_REGISTER:
-      handle_register(socket, identity, &msg);
-      break;
-    case MSG_CREATE_GAME:
-      handle_create_game(socket, identity, &msg);
-      break;
-    case MSG_JOIN_GAME:
-      handle_join_game(socket, identity, &msg);
-      break;
-    case MSG_INVITE_PLAYER:
-      handle_invite_player(socket, identity, &msg);
-      break;
-    case MSG_PLACE_SHIP:
-      handle_place_ship(socket, identity, &msg);
-      break;
-    case MSG_GAME_STATE:
-      handle_game_state(socket, identity, &msg);
-      break;
-    case MSG_MAKE_SHOT:
-      handle_make_shot(socket, identity, &msg);
-      break;
-    case MSG_LIST_GAMES:
-      handle_list_games(socket, identity, &msg);
-      break;
-    default:
-      printf("Unknown message type: %d\n", msg.type);
-      break;
+  // Каталог - только лобби, шард игр - только воркеры
+  int first = role == ROLE_GAMES ? 1 : 0;
+  int last = role == ROLE_DIRECTORY ? 0 : worker_count;
+  for (int i = first; i <= last; i++) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, thread_main, &threads[i]) != 0) {
+      fprintf(stderr, "Error starting server thread\n");
+      return 1;
     }
+    pthread_detach(tid);
   }
 
-  zmq_close(socket);
-  zmq_ctx_destroy(context);
+  static const char *role_names[] = {"server", "directory shard",
+                                     "game shard"};
+  printf("Sea Battle %s started on port %d (%d game workers)\n",
+         role_names[role], port, role == ROLE_DIRECTORY ? 0 : worker_count);
+  printf("Metrics on %s\n", metrics_endpoint);
+  printf("Spectators on %s\n", spectator_endpoint);
+  printf("Waiting for %s...\n",
+         role == ROLE_STANDALONE ? "clients" : "the broker");
+
+  frontend_run(&frontend);
+
+  // Потоки не останавливаем: достаточно дописать журнал
+  printf("Shutting down...\n");
+  journal_stop();
+  archive_stop();
   return 0;
 }
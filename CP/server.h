@@ -0,0 +1,76 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "archive.h"
+#include "bot.h"
+#include "common.h"
+#include "journal.h"
+#include "log.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "reactor.h"
+#include "registry.h"
+#include "spectator.h"
+#include "timer.h"
+
+#define LOBBY_ENDPOINT "inproc://lobby"
+#define WORKER_ENDPOINT "inproc://worker-%d"
+#define MAX_WORKERS 64
+#define IDENTITY_SIZE 256
+// Кадров в inproc-очереди между фронтендом и потоком, в каждую сторону
+#define THREAD_QUEUE 65536
+
+// Лимиты времени, секунды. На расстановку флота даётся PLACE_LIMIT_TURNS
+// ходов; игрок вне партии без запросов дольше лимита простоя выходит,
+// открытая игра без соперника столько же ждёт и снимается.
+#define DEFAULT_TURN_LIMIT 60
+#define DEFAULT_IDLE_LIMIT 600
+#define TURN_LIMIT_MIN 5
+#define TURN_LIMIT_MAX 3600
+#define PLACE_LIMIT_TURNS 3
+
+// Роль процесса. Один процесс - всё сразу, клиенты подключаются к нему.
+// За брокером (broker.c) процессы делятся: каталог держит игроков и
+// каталог игр (только лобби), шарды игр - партии (только воркеры).
+// Тогда вместо ROUTER для клиентов процесс слушает DEALER, к которому
+// подключается брокер, и внутренние сообщения между лобби и воркерами
+// идут через брокер.
+typedef enum { ROLE_STANDALONE, ROLE_DIRECTORY, ROLE_GAMES } ServerRole;
+
+// Поток-владелец состояния: лобби (игроки и каталог игр) или игровой
+// воркер (партии, чей id попадает на этот воркер). Каждый поток работает
+// только со своим реестром, поэтому блокировки не нужны.
+typedef struct {
+  int index; // номер воркера, -1 - лобби
+  void *context;
+  void *socket; // PAIR к фронтенду
+  void *spectators; // PUSH к потоку трансляции (только воркеры)
+  Registry registry;
+  ThreadMetrics *metrics;
+  TimerWheel timers; // лобби - по игрокам, воркер - по партиям
+  uint32_t turn_limit;
+  uint32_t idle_limit;
+  bool sharded; // лобби и воркеры в разных процессах, журналы у каждого свои
+  uint32_t bot_rng; // генератор ботов воркера
+  size_t identity_len; // длина identity текущего сообщения
+} ServerThread;
+
+typedef void (*ThreadDispatch)(ServerThread *t, char *identity, Message *msg);
+
+// Кадры между фронтендом и потоками: [identity][payload].
+// Пустой identity означает внутреннее сообщение между потоками,
+// фронтенд маршрутизирует его так же, как запрос клиента. Отправка не
+// ждёт: при полной очереди кадр теряется и учитывается в метриках.
+void server_send(void *socket, const char *identity, Message *msg);
+void internal_send(void *socket, Message *msg);
+void reply_status(void *socket, const char *identity, MessageType type,
+                  StatusCode status);
+
+// Цикл лобби или воркера: сообщения фронтенда пачками и таймеры потока
+void server_thread_run(ServerThread *t, ThreadDispatch dispatch,
+                       TimerFire fire);
+
+void *lobby_main(void *arg);
+void *worker_main(void *arg);
+
+#endif // SERVER_H
@@ -0,0 +1,291 @@
+#include "spectator.h"
+#include "log.h"
+#include "protocol.h"
+#include "registry.h"
+#include <errno.h>
+#include <pthread.h>
+
+#define SPECTATOR_INPROC "inproc://spectators"
+#define SPECTATOR_QUEUE 10000 // событий в очереди воркера, дальше теряются
+#define CELLS (BOARD_SIZE * BOARD_SIZE)
+
+// Открытая часть партии, как её видит зритель
+typedef struct {
+  int64_t id; // 0 - запись свободна
+  int turn;
+  bool snapshot_due; // была подписка, снимок ещё не отправлен
+  char name[MAX_GAME_NAME];
+  char players[MAX_PLAYERS][MAX_PLAYER_NAME];
+  char cells[MAX_PLAYERS][CELLS];
+} GameView;
+
+typedef struct {
+  void *events;    // PULL, события воркеров
+  void *context;   // отдельный контекст для рассылки
+  void *publisher; // XPUB
+  // Партии по слоту id: слоты лобби плотные, поиск - одно обращение
+  GameView *views;
+  size_t view_count;
+  uint32_t *due; // слоты, ждущие снимка
+  size_t due_count;
+} Spectator;
+
+static GameView *view_find(Spectator *s, int64_t id) {
+  size_t slot = POOL_SLOT(id);
+  if (id <= 0 || slot >= s->view_count || s->views[slot].id != id) {
+    return NULL;
+  }
+  return &s->views[slot];
+}
+
+static GameView *view_put(Spectator *s, int64_t id) {
+  size_t slot = POOL_SLOT(id);
+  if (id <= 0 || slot >= POOL_MAX_SLOTS) {
+    return NULL;
+  }
+  if (slot >= s->view_count) {
+    size_t count = s->view_count ? s->view_count : 256;
+    while (count <= slot) {
+      count *= 2;
+    }
+    uint32_t *due = realloc(s->due, count * sizeof(uint32_t));
+    if (due == NULL) {
+      return NULL;
+    }
+    s->due = due;
+    GameView *views = realloc(s->views, count * sizeof(GameView));
+    if (views == NULL) {
+      return NULL;
+    }
+    memset(views + s->view_count, 0,
+           (count - s->view_count) * sizeof(GameView));
+    s->views = views;
+    s->view_count = count;
+  }
+  GameView *view = &s->views[slot];
+  view->id = id;
+  return view;
+}
+
+static void publish(Spectator *s, int64_t game_id, const uint8_t *payload,
+                    size_t size) {
+  uint8_t topic[SPECTATOR_TOPIC_SIZE];
+  spectator_topic(game_id, topic);
+  zmq_send(s->publisher, topic, sizeof(topic), ZMQ_SNDMORE);
+  zmq_send(s->publisher, payload, size, 0);
+}
+
+static void publish_snapshot(Spectator *s, const GameView *view) {
+  Message msg = {0};
+  msg.type = MSG_GAME_STATE;
+  msg.game_id = view->id;
+  msg.x = view->turn;
+  strncpy(msg.game_name, view->name, MAX_GAME_NAME - 1);
+  strncpy(msg.sender, view->players[0], MAX_PLAYER_NAME - 1);
+  strncpy(msg.recipient, view->players[1], MAX_PLAYER_NAME - 1);
+  memcpy(msg.data, view->cells, sizeof(view->cells));
+
+  uint8_t buf[PROTO_MAX_FRAME];
+  size_t len = proto_encode(&msg, buf, sizeof(buf));
+  if (len > 0) {
+    publish(s, view->id, buf, len);
+  }
+}
+
+// Событие воркера: обновляем свою копию и публикуем кадр как есть
+static void handle_event(Spectator *s, const uint8_t *buf, size_t size) {
+  Message msg;
+  if (!proto_decode(buf, size, &msg)) {
+    return;
+  }
+
+  GameView *view;
+  switch (msg.type) {
+  case MSG_GAME_STATE:
+    view = view_put(s, msg.game_id);
+    if (view == NULL) {
+      log_error("Spectators: no memory for game %d", msg.game_id);
+      return;
+    }
+    view->turn = msg.x;
+    strncpy(view->name, msg.game_name, MAX_GAME_NAME - 1);
+    strncpy(view->players[0], msg.sender, MAX_PLAYER_NAME - 1);
+    strncpy(view->players[1], msg.recipient, MAX_PLAYER_NAME - 1);
+    memcpy(view->cells, msg.data, sizeof(view->cells));
+    break;
+  case MSG_SHOT_RESULT: {
+    view = view_find(s, msg.game_id);
+    if (view == NULL || msg.x < 0 || msg.x >= BOARD_SIZE || msg.y < 0 ||
+        msg.y >= BOARD_SIZE) {
+      return;
+    }
+    int target = strcmp(msg.recipient, view->players[1]) == 0 ? 1 : 0;
+    view->cells[target][msg.y * BOARD_SIZE + msg.x] =
+        msg.shot_result == SHOT_MISS ? 'o' : 'x';
+    view->turn = msg.shot_result == SHOT_MISS ? target : 1 - target;
+    break;
+  }
+  case MSG_GAME_OVER:
+    view = view_find(s, msg.game_id);
+    if (view != NULL) {
+      view->id = 0;
+    }
+    break;
+  default:
+    return;
+  }
+  publish(s, msg.game_id, buf, size);
+}
+
+// Уведомление XPUB: [1 - подписка, 0 - отписка][тема]
+static void handle_subscription(Spectator *s, const uint8_t *buf, int size) {
+  if (size != 1 + SPECTATOR_TOPIC_SIZE || buf[0] != 1) {
+    return;
+  }
+  uint64_t id = 0;
+  for (int i = 1; i <= SPECTATOR_TOPIC_SIZE; i++) {
+    id = id << 8 | buf[i];
+  }
+  GameView *view = view_find(s, (int64_t)id);
+  if (view != NULL && !view->snapshot_due) {
+    view->snapshot_due = true;
+    s->due[s->due_count++] = POOL_SLOT(id);
+  }
+}
+
+// Подписки, пришедшие пачкой, получают один снимок на партию
+static void flush_snapshots(Spectator *s) {
+  for (size_t i = 0; i < s->due_count; i++) {
+    GameView *view = &s->views[s->due[i]];
+    if (view->snapshot_due) {
+      view->snapshot_due = false;
+      publish_snapshot(s, view);
+    }
+  }
+  s->due_count = 0;
+}
+
+static void *spectator_main(void *arg) {
+  Spectator *s = arg;
+  zmq_pollitem_t items[] = {{s->events, 0, ZMQ_POLLIN, 0},
+                            {s->publisher, 0, ZMQ_POLLIN, 0}};
+
+  while (1) {
+    if (zmq_poll(items, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    uint8_t buf[PROTO_MAX_FRAME];
+    int size;
+    while ((size = zmq_recv(s->events, buf, sizeof(buf), ZMQ_DONTWAIT)) >= 0) {
+      if (size > 0 && (size_t)size <= sizeof(buf)) {
+        handle_event(s, buf, (size_t)size);
+      }
+    }
+    while ((size = zmq_recv(s->publisher, buf, sizeof(buf), ZMQ_DONTWAIT)) >=
+           0) {
+      handle_subscription(s, buf, size);
+    }
+    flush_snapshots(s);
+  }
+
+  return NULL;
+}
+
+bool spectator_start(void *context, const char *endpoint) {
+  static Spectator s;
+
+  // Сокеты создаются здесь и переходят к потоку трансляции при его
+  // запуске; inproc bind - до того, как воркеры сделают connect
+  s.events = zmq_socket(context, ZMQ_PULL);
+  if (zmq_bind(s.events, SPECTATOR_INPROC) != 0) {
+    fprintf(stderr, "Error binding %s: %s\n", SPECTATOR_INPROC,
+            zmq_strerror(errno));
+    return false;
+  }
+
+  // Каждая подписка приходит в XPUB, даже повторная: по ней новый
+  // зритель получает снимок
+  s.context = zmq_ctx_new();
+  s.publisher = zmq_socket(s.context, ZMQ_XPUB);
+  int verbose = 1;
+  zmq_setsockopt(s.publisher, ZMQ_XPUB_VERBOSE, &verbose, sizeof(verbose));
+  if (zmq_bind(s.publisher, endpoint) != 0) {
+    fprintf(stderr, "Error binding %s: %s\n", endpoint, zmq_strerror(errno));
+    return false;
+  }
+
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, spectator_main, &s) != 0) {
+    return false;
+  }
+  pthread_detach(tid);
+  return true;
+}
+
+void *spectator_connect(void *context) {
+  void *socket = zmq_socket(context, ZMQ_PUSH);
+  int hwm = SPECTATOR_QUEUE;
+  zmq_setsockopt(socket, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+  if (zmq_connect(socket, SPECTATOR_INPROC) != 0) {
+    log_error("Spectators: cannot connect: %s", zmq_strerror(errno));
+    zmq_close(socket);
+    return NULL;
+  }
+  return socket;
+}
+
+// Без ожидания: при полной очереди событие теряется
+static void post(void *socket, const Message *msg) {
+  uint8_t buf[PROTO_MAX_FRAME];
+  size_t len = proto_encode(msg, buf, sizeof(buf));
+  if (socket != NULL && len > 0) {
+    zmq_send(socket, buf, len, ZMQ_DONTWAIT);
+  }
+}
+
+void spectator_game_started(void *socket, const Game *game) {
+  Message msg = {0};
+  msg.type = MSG_GAME_STATE;
+  msg.game_id = game->id;
+  msg.x = game->current_turn;
+  strncpy(msg.game_name, game->name, MAX_GAME_NAME - 1);
+  strncpy(msg.sender, game->players[0], MAX_PLAYER_NAME - 1);
+  strncpy(msg.recipient, game->players[1], MAX_PLAYER_NAME - 1);
+  for (int i = 0; i < MAX_PLAYERS; i++) {
+    const Board *board = &game->boards[i];
+    for (int cell = 0; cell < CELLS; cell++) {
+      char c = '.';
+      if (board_is_shot(board, cell % BOARD_SIZE, cell / BOARD_SIZE)) {
+        c = board->ship_at[cell] != 0 ? 'x' : 'o';
+      }
+      msg.data[i * CELLS + cell] = c;
+    }
+  }
+  post(socket, &msg);
+}
+
+void spectator_shot(void *socket, const Game *game, int shooter, int x, int y,
+                    ShotResult result) {
+  Message msg = {0};
+  msg.type = MSG_SHOT_RESULT;
+  msg.game_id = game->id;
+  msg.x = x;
+  msg.y = y;
+  msg.shot_result = result;
+  strncpy(msg.sender, game->players[shooter], MAX_PLAYER_NAME - 1);
+  strncpy(msg.recipient, game->players[1 - shooter], MAX_PLAYER_NAME - 1);
+  post(socket, &msg);
+}
+
+void spectator_game_over(void *socket, const Game *game, int winner) {
+  Message msg = {0};
+  msg.type = MSG_GAME_OVER;
+  msg.game_id = game->id;
+  if (winner >= 0) {
+    strncpy(msg.sender, game->players[winner], MAX_PLAYER_NAME - 1);
+  }
+  post(socket, &msg);
+}
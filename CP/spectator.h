@@ -0,0 +1,52 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include "common.h"
+
+// Трансляция идущих партий зрителям.
+//
+// Воркер после начала партии, каждого выстрела и конца игры кладёт
+// событие в свой inproc PUSH-сокет без ожидания: если поток трансляции
+// не успевает, событие теряется, а игроки не ждут. Поток трансляции
+// хранит открытую часть полей (попадания и промахи, без кораблей) и
+// рассылает события через XPUB на порту сервера + SPECTATOR_PORT_OFFSET
+// (по умолчанию SPECTATOR_PORT). XPUB живёт в отдельном контексте
+// ZeroMQ, поэтому рассылка тысячам подписчиков идёт в своём потоке
+// ввода-вывода, а не в том, что обслуживает игроков.
+//
+// Кадры публикации: [тема][сообщение протокола]. Тема - game_id, 4 байта
+// big-endian (фиксированная длина: тема 12 не совпадает с префиксом 123).
+// Зритель подписывается на тему и получает:
+//   MSG_GAME_STATE  - снимок: sender/recipient - игроки 0 и 1, x - чей
+//                     ход, data - 2 * 100 клеток ('.', 'o' - промах,
+//                     'x' - попадание), сначала поле игрока 0
+//   MSG_SHOT_RESULT - выстрел: sender стрелял по полю recipient в (x, y)
+//   MSG_GAME_OVER   - конец партии, sender - победитель (пусто, если
+//                     партия снята по тайм-ауту)
+// Снимок публикуется при начале партии и после новых подписок на неё,
+// дальше идут изменения. Выстрелы можно применять повторно.
+#define SPECTATOR_PORT "5557"
+#define SPECTATOR_PORT_OFFSET 2
+#define SPECTATOR_TOPIC_SIZE 8
+
+static inline void spectator_topic(int64_t game_id,
+                                   uint8_t topic[SPECTATOR_TOPIC_SIZE]) {
+  uint64_t id = (uint64_t)game_id;
+  for (int i = 0; i < SPECTATOR_TOPIC_SIZE; i++) {
+    topic[i] = (uint8_t)(id >> (8 * (SPECTATOR_TOPIC_SIZE - 1 - i)));
+  }
+}
+
+// Поток трансляции; вызывается до запуска воркеров
+bool spectator_start(void *context, const char *endpoint);
+
+// PUSH-сокет воркера к потоку трансляции
+void *spectator_connect(void *context);
+
+void spectator_game_started(void *socket, const Game *game);
+void spectator_shot(void *socket, const Game *game, int shooter, int x, int y,
+                    ShotResult result);
+// winner -1 - без победителя
+void spectator_game_over(void *socket, const Game *game, int winner);
+
+#endif // SPECTATOR_H
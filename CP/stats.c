@@ -0,0 +1,68 @@
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+
+int hist_bucket(uint64_t v) {
+  if (v < HIST_SUB_BUCKETS) {
+    return (int)v;
+  }
+  int exp = 63 - __builtin_clzll(v); // >= HIST_SUB_BITS
+  int sub = (int)(v >> (exp - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+  return (exp - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+// Верхняя граница интервала
+static uint64_t bucket_value(int bucket) {
+  if (bucket < HIST_SUB_BUCKETS) {
+    return (uint64_t)bucket;
+  }
+  int exp = bucket / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+  uint64_t sub = (uint64_t)(bucket % HIST_SUB_BUCKETS) + HIST_SUB_BUCKETS;
+  return ((sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+void hist_reset(Histogram *h) { memset(h, 0, sizeof(*h)); }
+
+void hist_record(Histogram *h, uint64_t value) {
+  h->counts[hist_bucket(value)]++;
+  h->total++;
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total += src->total;
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+uint64_t hist_percentile(const Histogram *h, double q) {
+  if (h->total == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)(q * (double)h->total);
+  if (rank >= h->total) {
+    rank = h->total - 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen > rank) {
+      uint64_t v = bucket_value(i);
+      return v < h->max ? v : h->max;
+    }
+  }
+  return h->max;
+}
+
+uint64_t stats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,30 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Лог-линейная гистограмма задержек: на каждую степень двойки
+// HIST_SUB_BUCKETS интервалов, погрешность перцентиля около 3%.
+#define HIST_SUB_BITS 5
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t max;
+} Histogram;
+
+// Номер интервала для значения (для своих счётчиков поверх тех же интервалов)
+int hist_bucket(uint64_t value);
+
+void hist_reset(Histogram *h);
+void hist_record(Histogram *h, uint64_t value);
+void hist_merge(Histogram *dst, const Histogram *src);
+// q в диапазоне [0, 1]; 0 для пустой гистограммы
+uint64_t hist_percentile(const Histogram *h, double q);
+
+uint64_t stats_now_ns(void);
+
+#endif // STATS_H
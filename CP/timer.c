@@ -0,0 +1,90 @@
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_NS ((uint64_t)TIMER_TICK_MS * 1000000ull)
+
+bool timer_wheel_init(TimerWheel *w, uint64_t now_ns) {
+  memset(w, 0, sizeof(*w));
+  w->slots = calloc(TIMER_WHEEL_SLOTS, sizeof(TimerSlot));
+  w->origin_ns = now_ns;
+  return w->slots != NULL;
+}
+
+void timer_wheel_free(TimerWheel *w) {
+  if (w->slots != NULL) {
+    for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      free(w->slots[i].items);
+    }
+  }
+  free(w->slots);
+  free(w->spare.items);
+  memset(w, 0, sizeof(*w));
+}
+
+bool timer_arm(TimerWheel *w, int64_t id, uint32_t deadline) {
+  if (deadline <= w->now) {
+    deadline = w->now + 1;
+  }
+  TimerSlot *slot = &w->slots[deadline & (TIMER_WHEEL_SLOTS - 1)];
+  if (slot->count == slot->capacity) {
+    uint32_t capacity = slot->capacity ? slot->capacity * 2 : 8;
+    TimerEntry *items = realloc(slot->items, capacity * sizeof(TimerEntry));
+    if (items == NULL) {
+      return false;
+    }
+    slot->items = items;
+    slot->capacity = capacity;
+  }
+  slot->items[slot->count++] = (TimerEntry){id, deadline};
+  w->count++;
+  return true;
+}
+
+// Записи слота забираются целиком: обработчик может взводить таймеры,
+// в том числе в этот же слот
+static void run_slot(TimerWheel *w, TimerFire fire, void *ctx) {
+  size_t index = w->now & (TIMER_WHEEL_SLOTS - 1);
+  TimerSlot due = w->slots[index];
+  w->slots[index] = w->spare;
+  w->count -= due.count;
+
+  for (uint32_t i = 0; i < due.count; i++) {
+    TimerEntry e = due.items[i];
+    if (e.deadline > w->now) {
+      timer_arm(w, e.id, e.deadline); // следующий оборот
+      continue;
+    }
+    uint32_t next = fire(ctx, e.id, w->now);
+    if (next != 0) {
+      timer_arm(w, e.id, next);
+    }
+  }
+
+  due.count = 0;
+  w->spare = due;
+}
+
+void timer_wheel_advance(TimerWheel *w, uint64_t now_ns, TimerFire fire,
+                         void *ctx) {
+  uint32_t target = (uint32_t)((now_ns - w->origin_ns) / TICK_NS);
+  // После долгой паузы достаточно пройти каждый слот один раз
+  if (target - w->now > TIMER_WHEEL_SLOTS) {
+    w->now = target - TIMER_WHEEL_SLOTS;
+  }
+  while (w->now != target) {
+    w->now++;
+    run_slot(w, fire, ctx);
+  }
+}
+
+int timer_wheel_timeout_ms(const TimerWheel *w, uint64_t now_ns) {
+  if (w->count == 0) {
+    return -1;
+  }
+  uint64_t next_ns = w->origin_ns + (uint64_t)(w->now + 1) * TICK_NS;
+  if (now_ns >= next_ns) {
+    return 0;
+  }
+  return (int)((next_ns - now_ns + 999999) / 1000000);
+}
@@ -0,0 +1,64 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Хэшированное колесо таймеров потока сервера.
+//
+// Время идёт тиками по TIMER_TICK_MS от создания колеса. Таймер - пара
+// (id записи, срок в тиках) в слоте срок % TIMER_WHEEL_SLOTS; за тик
+// обрабатывается один слот, поэтому срабатывание стоит O(1) в среднем
+// при любом числе взведённых таймеров. Таймер со сроком дальше одного
+// оборота остаётся в слоте до своего оборота.
+//
+// Отмены нет: на запись держится один таймер, а её настоящий срок лежит
+// в самой записи. При срабатывании обработчик находит запись по id и
+// либо переносит таймер на её текущий срок, либо выполняет действие.
+// Так частые продления (каждый ход, каждое сообщение) стоят одну запись
+// в поле, а не операцию над колесом.
+#define TIMER_TICK_MS 100
+#define TIMER_WHEEL_SLOTS 4096 // степень двойки; оборот - 409.6 с
+
+typedef struct {
+  int64_t id;
+  uint32_t deadline;
+} TimerEntry;
+
+typedef struct {
+  TimerEntry *items;
+  uint32_t count;
+  uint32_t capacity;
+} TimerSlot;
+
+typedef struct {
+  TimerSlot *slots;
+  TimerSlot spare; // буфер для обмена со слотом при его обработке
+  uint64_t origin_ns;
+  uint32_t now; // последний обработанный тик
+  size_t count;
+} TimerWheel;
+
+// Срок записи id наступил. Возвращает новый срок (тик), если таймер
+// нужен дальше, или 0.
+typedef uint32_t (*TimerFire)(void *ctx, int64_t id, uint32_t now);
+
+static inline uint32_t timer_ticks(uint32_t seconds) {
+  return seconds * (1000 / TIMER_TICK_MS);
+}
+
+bool timer_wheel_init(TimerWheel *w, uint64_t now_ns);
+void timer_wheel_free(TimerWheel *w);
+
+// Срок в прошлом или текущий тик срабатывает на следующем тике
+bool timer_arm(TimerWheel *w, int64_t id, uint32_t deadline);
+
+// Обрабатывает тики до момента now_ns
+void timer_wheel_advance(TimerWheel *w, uint64_t now_ns, TimerFire fire,
+                         void *ctx);
+
+// Сколько ждать следующего тика, -1 - таймеров нет
+int timer_wheel_timeout_ms(const TimerWheel *w, uint64_t now_ns);
+
+#endif // TIMER_H
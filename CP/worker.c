@@ -0,0 +1,573 @@
+#include "server.h"
+#include <stdio.h>
+
+// Партии с ботом не пишутся в журнал: лобби их тоже не журналирует,
+// после перезапуска такой партии нет
+static bool journaled(const Game *game) {
+  for (int i = 0; i < game->player_count; i++) {
+    if (game->player_refs[i] != NULL && game->player_refs[i]->bot) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Рассылка очерёдности хода обоим игрокам
+static void notify_turn(ServerThread *t, Game *game) {
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p != NULL && !p->bot) {
+      Message state = {0};
+      state.type = MSG_GAME_STATE;
+      state.game_id = game->id;
+      state.status =
+          (i == game->current_turn) ? ST_YOUR_TURN : ST_OPPONENT_TURN;
+      server_send(t->socket, p->identity, &state);
+    }
+  }
+}
+
+static bool all_players_ready(const Game *game) {
+  if (game->player_count < MAX_PLAYERS) {
+    return false;
+  }
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p == NULL || !p->ready) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Расстановка закончена у обоих: партия начинается
+static void start_game(ServerThread *t, Game *game) {
+  game->status = GAME_PLAYING;
+  game->current_turn = 0;
+  game->deadline = t->timers.now + timer_ticks(game->turn_limit);
+
+  Message started = {0};
+  started.type = MSG_GAME_STATE;
+  started.game_id = game->id;
+  internal_send(t->socket, &started);
+
+  notify_turn(t, game);
+  spectator_game_started(t->spectators, game);
+  archive_game_started(game, t->timers.now);
+  log_info("Game '%s' started, %s's turn", game->name,
+           game->players[game->current_turn]);
+}
+
+// Игроки нужны воркеру только на время партии: следующая их партия
+// может попасть на другой воркер
+static void finish_game(ServerThread *t, Game *game) {
+  Player *players[MAX_PLAYERS];
+  int count = game->player_count;
+  memcpy(players, game->player_refs, sizeof(players));
+
+  registry_finish_game(&t->registry, game);
+  for (int i = 0; i < count; i++) {
+    if (players[i] != NULL && !players[i]->in_game) {
+      if (t->sharded && !players[i]->bot) {
+        journal_logout(players[i]->login);
+      }
+      registry_remove_player(&t->registry, players[i]);
+    }
+  }
+}
+
+// Конец партии для лобби, игроков и зрителей. winner -1 - партия снята
+// без победителя; won и lost - статусы победителю и проигравшему.
+static void end_game(ServerThread *t, Game *game, int winner, StatusCode won,
+                     StatusCode lost) {
+  if (journaled(game)) {
+    journal_finish(game->id);
+  }
+
+  // Лобби освобождает игроков до того, как они получат MSG_GAME_OVER
+  Message finished = {0};
+  finished.type = MSG_GAME_OVER;
+  finished.game_id = game->id;
+  internal_send(t->socket, &finished);
+
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p != NULL && !p->bot) {
+      Message game_over = {0};
+      game_over.type = MSG_GAME_OVER;
+      game_over.status = winner < 0 ? ST_GAME_ABANDONED
+                         : i == winner ? won
+                                       : lost;
+      server_send(t->socket, p->identity, &game_over);
+    }
+  }
+
+  spectator_game_over(t->spectators, game, winner);
+  archive_game_over(game, winner, won == ST_OPPONENT_TIMED_OUT);
+  if (winner < 0) {
+    log_info("Game '%s' abandoned", game->name);
+  } else {
+    log_info("Game '%s' finished. Winner: %s", game->name,
+             game->players[winner]);
+  }
+  finish_game(t, game);
+}
+
+// Срок хода или расстановки. Не успевший игрок проигрывает, если флот
+// не расставил никто - партия снимается. Таймер партии срабатывает не
+// реже раза за ход: так срок, ставший ближе (начало партии после
+// расстановки), тоже не пропускается.
+static uint32_t game_timer(void *ctx, int64_t id, uint32_t now) {
+  ServerThread *t = ctx;
+  Game *game = registry_find_game_by_id(&t->registry, id);
+  if (game == NULL || (game->status != GAME_PLACING_SHIPS &&
+                       game->status != GAME_PLAYING)) {
+    return 0;
+  }
+  if (game->deadline > now) {
+    uint32_t check = now + timer_ticks(game->turn_limit);
+    return game->deadline < check ? game->deadline : check;
+  }
+
+  int late = game->current_turn;
+  if (game->status == GAME_PLACING_SHIPS) {
+    bool ready[MAX_PLAYERS];
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+      ready[i] = game->player_refs[i] != NULL && game->player_refs[i]->ready;
+    }
+    late = ready[0] == ready[1] ? -1 : ready[0] ? 1 : 0;
+  }
+
+  if (late < 0) {
+    end_game(t, game, -1, ST_NONE, ST_NONE);
+  } else {
+    log_info("Game '%s': %s ran out of time", game->name,
+             game->players[late]);
+    end_game(t, game, 1 - late, ST_OPPONENT_TIMED_OUT, ST_TIMED_OUT);
+  }
+  return 0;
+}
+
+static void handle_place_ship(ServerThread *t, char *identity, Player *player,
+                              Message *msg) {
+  if (player == NULL || !player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_id(&t->registry, player->game_id);
+  if (game == NULL || game->status != GAME_PLACING_SHIPS) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CANNOT_PLACE);
+    return;
+  }
+
+  // Определяем индекс игрока
+  int player_idx = game_player_index(game, player);
+
+  if (player_idx == -1) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CANNOT_PLACE);
+    return;
+  }
+
+  // Парсим данные о корабле из msg->data (формат: "x,y,size,horizontal")
+  int x = -1, y = -1;
+  int size = 0;
+  int horizontal = 1;
+
+  if (sscanf(msg->data, "%d,%d,%d,%d", &x, &y, &size, &horizontal) < 3) {
+    // Используем значения из структуры
+    size = 1; // По умолчаниюs
+  }
+
+  if (board_place_ship(&game->boards[player_idx], x, y, size, horizontal)) {
+    if (journaled(game)) {
+      journal_place_ship(game->id, player_idx, x, y, size, horizontal);
+    }
+    log_debug("Player %s has placed %d ships", player->login,
+              game->boards[player_idx].ship_count);
+
+    if (game->boards[player_idx].ship_count == MAX_SHIPS) {
+      game->ships_remaining[player_idx] = MAX_SHIPS;
+      player->ready = true;
+      log_debug("Player %s is ready", player->login);
+    }
+
+    reply_status(t->socket, identity, MSG_ACK, ST_SHIP_PLACED);
+
+    if (player->ready && all_players_ready(game)) {
+      start_game(t, game);
+    }
+  } else {
+    reply_status(t->socket, identity, MSG_ERROR, ST_INVALID_PLACEMENT);
+  }
+}
+
+// Весь флот одним сообщением: принимается целиком или отклоняется
+static void handle_place_fleet(ServerThread *t, char *identity, Player *player,
+                               Message *msg) {
+  if (player == NULL || !player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_id(&t->registry, player->game_id);
+  int player_idx = game ? game_player_index(game, player) : -1;
+  if (game == NULL || game->status != GAME_PLACING_SHIPS ||
+      player_idx == -1 || game->boards[player_idx].ship_count != 0) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CANNOT_PLACE);
+    return;
+  }
+
+  int bad_ship;
+  if (!board_place_fleet(&game->boards[player_idx], msg->fleet, &bad_ship)) {
+    Message response = {0};
+    response.type = MSG_ERROR;
+    response.status = ST_INVALID_FLEET;
+    response.x = bad_ship;
+    server_send(t->socket, identity, &response);
+    return;
+  }
+
+  if (journaled(game)) {
+    journal_place_fleet(game->id, player_idx, msg->fleet);
+  }
+  game->ships_remaining[player_idx] = MAX_SHIPS;
+  player->ready = true;
+  log_debug("Player %s placed the fleet and is ready", player->login);
+
+  reply_status(t->socket, identity, MSG_ACK, ST_FLEET_PLACED);
+
+  if (all_players_ready(game)) {
+    start_game(t, game);
+  }
+}
+
+// Текущее состояние по запросу клиента (например, после переподключения).
+// Начало партии и смену хода воркер рассылает сам.
+static void handle_game_state(ServerThread *t, char *identity,
+                              Player *player) {
+  if (player == NULL || !player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_id(&t->registry, player->game_id);
+  if (game == NULL) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Message response = {0};
+  response.type = MSG_GAME_STATE;
+  response.game_id = game->id;
+  if (game->status != GAME_PLAYING) {
+    response.status = ST_OPPONENT_PREPARING;
+  } else if (game->player_refs[game->current_turn] == player) {
+    response.status = ST_YOUR_TURN;
+  } else {
+    response.status = ST_OPPONENT_TURN;
+  }
+  server_send(t->socket, identity, &response);
+}
+
+// Выстрел игрока shooter, ход уже проверен; false - партия кончилась
+static bool fire(ServerThread *t, Game *game, int shooter, int x, int y) {
+  int opponent_idx = 1 - shooter;
+  ShotResult result = board_shot(&game->boards[opponent_idx], x, y);
+  if (journaled(game)) {
+    journal_shot(game->id, shooter, x, y);
+  }
+  archive_shot(game, x, y, result, t->timers.now);
+
+  if (result == SHOT_MISS) {
+    game->current_turn = opponent_idx;
+  } else if (result == SHOT_SUNK) {
+    game->ships_remaining[opponent_idx]--;
+  }
+  game->deadline = t->timers.now + timer_ticks(game->turn_limit);
+
+  Message response = {0};
+  response.type = MSG_SHOT_RESULT;
+  response.x = x;
+  response.y = y;
+  response.shot_result = result;
+
+  Player *p = game->player_refs[shooter];
+  if (p != NULL && !p->bot) {
+    server_send(t->socket, p->identity, &response);
+  }
+  p = game->player_refs[opponent_idx];
+  if (p != NULL && !p->bot) {
+    response.status = ST_OPPONENT_SHOT;
+    server_send(t->socket, p->identity, &response);
+  }
+
+  // Зрителям - после ответов игрокам
+  spectator_shot(t->spectators, game, shooter, x, y, result);
+
+  if (game->ships_remaining[opponent_idx] == 0) {
+    end_game(t, game, shooter, ST_YOU_WON, ST_YOU_LOST);
+    return false;
+  }
+
+  notify_turn(t, game);
+  return true;
+}
+
+// Бот ходит сразу, пока ход за ним: выбор выстрела стоит микросекунды,
+// так что таймер для этого не нужен
+static void bot_moves(ServerThread *t, Game *game) {
+  while (1) {
+    int turn = game->current_turn;
+    Player *p = game->player_refs[turn];
+    if (p == NULL || !p->bot) {
+      return;
+    }
+    int cell = bot_choose_shot(&game->boards[1 - turn], &t->bot_rng);
+    if (cell < 0 || !fire(t, game, turn, cell % BOARD_SIZE,
+                          cell / BOARD_SIZE)) {
+      return;
+    }
+  }
+}
+
+static void handle_make_shot(ServerThread *t, char *identity, Player *player,
+                             Message *msg) {
+  if (player == NULL || !player->in_game) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_IN_GAME);
+    return;
+  }
+
+  Game *game = registry_find_game_by_id(&t->registry, player->game_id);
+  if (game == NULL || game->status != GAME_PLAYING) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_CANNOT_SHOOT);
+    return;
+  }
+
+  int player_idx = game_player_index(game, player);
+
+  if (player_idx == -1 || player_idx != game->current_turn) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_NOT_YOUR_TURN);
+    return;
+  }
+
+  int x = msg->x;
+  int y = msg->y;
+
+  if (x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_INVALID_COORDS);
+    return;
+  }
+
+  if (board_is_shot(&game->boards[1 - player_idx], x, y)) {
+    reply_status(t->socket, identity, MSG_ERROR, ST_ALREADY_SHOT);
+    return;
+  }
+
+  if (fire(t, game, player_idx, x, y)) {
+    bot_moves(t, game);
+  }
+}
+
+static Player *attach_player(ServerThread *t, const char *login,
+                             const char *identity, uint64_t session) {
+  Player *p = registry_find_player(&t->registry, login);
+  if (p != NULL) {
+    registry_update_identity(p, identity, strlen(identity));
+  } else {
+    p = registry_add_player(&t->registry, login, identity);
+  }
+  if (p != NULL) {
+    p->session = session;
+  }
+  return p;
+}
+
+// Игрок, приславший запрос. С дескриптором сессии партия берётся по
+// game_id запроса (прямой индекс), а игрок - среди её участников по
+// целому числу; клиенты без дескриптора ищутся по логину.
+static Player *find_sender(ServerThread *t, const Message *msg) {
+  if (msg->session == 0) {
+    return registry_find_player(&t->registry, msg->sender);
+  }
+  Game *game = registry_find_game_by_id(&t->registry, msg->game_id);
+  if (game == NULL) {
+    return NULL;
+  }
+  for (int i = 0; i < game->player_count; i++) {
+    Player *p = game->player_refs[i];
+    if (p != NULL && p->session == msg->session) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+// Лобби создало партию с id, попадающим на этот воркер
+static void handle_setup_game(ServerThread *t, Message *msg) {
+  Player *creator = attach_player(t, msg->sender, msg->data, msg->session);
+  Game *game = NULL;
+  if (creator != NULL) {
+    game = registry_create_game_with_id(&t->registry, msg->game_id,
+                                        msg->game_name, creator);
+  }
+  if (game == NULL) {
+    log_error("Worker %d: failed to set up game %d", t->index,
+              msg->game_id);
+    return;
+  }
+  game->turn_limit = msg->x > 0 ? (uint32_t)msg->x : t->turn_limit;
+
+  // Журнал шарда игр сам восстанавливает свои партии: игрок и партия
+  // записываются здесь, а не в лобби каталога
+  if (t->sharded) {
+    journal_register((int64_t)creator->session, creator->login);
+    journal_create(game->id, creator->login, game->name);
+  }
+}
+
+// Срок отсчитывается с момента, когда в партии двое, или с перезапуска;
+// первая проверка - через ход, дальше см. game_timer
+static void arm_game_timer(ServerThread *t, Game *game) {
+  uint32_t limit = game->status == GAME_PLAYING
+                       ? game->turn_limit
+                       : game->turn_limit * PLACE_LIMIT_TURNS;
+  uint32_t now = t->timers.now;
+  game->deadline = now + timer_ticks(limit);
+  timer_arm(&t->timers, game->id, now + timer_ticks(game->turn_limit));
+}
+
+// Партия против бота: человек - игрок 0, бот с готовым флотом - игрок 1.
+// Первым ходит человек, дальше ходы бота делает bot_moves.
+static void handle_setup_bot(ServerThread *t, Message *msg) {
+  Player *human = attach_player(t, msg->sender, msg->data, msg->session);
+  Game *game = NULL;
+  if (human != NULL) {
+    game = registry_create_game_with_id(&t->registry, msg->game_id,
+                                        msg->game_name, human);
+  }
+  if (game == NULL) {
+    log_error("Worker %d: failed to set up bot game %d", t->index,
+              msg->game_id);
+    return;
+  }
+  game->turn_limit = msg->x > 0 ? (uint32_t)msg->x : t->turn_limit;
+
+  char login[MAX_PLAYER_NAME];
+  snprintf(login, sizeof(login), BOT_LOGIN_PREFIX "%lld",
+           (long long)game->id);
+  Player *bot = registry_add_player(&t->registry, login, "");
+  if (bot == NULL || !registry_join_game(&t->registry, game, bot)) {
+    log_error("Worker %d: no room for the bot of game %d", t->index,
+              game->id);
+    if (bot != NULL) {
+      registry_remove_player(&t->registry, bot);
+    }
+    end_game(t, game, -1, ST_NONE, ST_NONE);
+    return;
+  }
+  bot->bot = true;
+  uint8_t fleet[MAX_SHIPS];
+  int bad_ship;
+  fleet_random(fleet, &t->bot_rng);
+  board_place_fleet(&game->boards[1], fleet, &bad_ship);
+  game->ships_remaining[1] = MAX_SHIPS;
+  bot->ready = true;
+  arm_game_timer(t, game);
+}
+
+static void handle_setup_join(ServerThread *t, Message *msg) {
+  Game *game = registry_find_game_by_id(&t->registry, msg->game_id);
+  Player *player = attach_player(t, msg->sender, msg->data, msg->session);
+  if (game == NULL || player == NULL ||
+      !registry_join_game(&t->registry, game, player)) {
+    log_error("Worker %d: failed to join %s to game %d", t->index,
+              msg->sender, msg->game_id);
+    return;
+  }
+  if (t->sharded) {
+    journal_register((int64_t)player->session, player->login);
+    journal_join(game->id, player->login);
+  }
+  arm_game_timer(t, game);
+}
+
+// Лобби сняло открытую игру, которую никто не занял
+static void handle_cancel_game(ServerThread *t, Message *msg) {
+  Game *game = registry_find_game_by_id(&t->registry, msg->game_id);
+  if (game != NULL && game->status == GAME_WAITING) {
+    if (t->sharded) {
+      journal_finish(game->id);
+    }
+    finish_game(t, game);
+  }
+}
+
+static void worker_dispatch(ServerThread *t, char *identity, Message *msg) {
+  if (t->identity_len == 0) {
+    switch (msg->type) {
+    case MSG_CREATE_GAME:
+      handle_setup_game(t, msg);
+      break;
+    case MSG_JOIN_GAME:
+      handle_setup_join(t, msg);
+      break;
+    case MSG_PLAY_BOT:
+      handle_setup_bot(t, msg);
+      break;
+    case MSG_GAME_OVER:
+      handle_cancel_game(t, msg);
+      break;
+    default:
+      log_warn("Unknown internal message type: %d", msg->type);
+      break;
+    }
+    return;
+  }
+
+  Player *p = find_sender(t, msg);
+  if (p) {
+    registry_update_identity(p, identity, t->identity_len);
+  }
+
+  switch (msg->type) {
+  case MSG_PLACE_SHIP:
+    handle_place_ship(t, identity, p, msg);
+    break;
+  case MSG_PLACE_FLEET:
+    handle_place_fleet(t, identity, p, msg);
+    break;
+  case MSG_GAME_STATE:
+    handle_game_state(t, identity, p);
+    break;
+  case MSG_MAKE_SHOT:
+    handle_make_shot(t, identity, p, msg);
+    break;
+  default:
+    log_warn("Unknown message type: %d", msg->type);
+    break;
+  }
+}
+
+void *worker_main(void *arg) {
+  ServerThread *t = arg;
+  metrics_bind(t->metrics);
+
+  // Партии, восстановленные из журнала, снова видны зрителям. Лимит
+  // хода в журнал не пишется, у них он по умолчанию, отсчёт - заново.
+  t->spectators = spectator_connect(t->context);
+  size_t cursor = 0;
+  Game *g;
+  while ((g = registry_next_game(&t->registry, &cursor)) != NULL) {
+    g->turn_limit = t->turn_limit;
+    if (g->status == GAME_PLAYING) {
+      spectator_game_started(t->spectators, g);
+    }
+    if (g->status == GAME_PLACING_SHIPS || g->status == GAME_PLAYING) {
+      arm_game_timer(t, g);
+    }
+  }
+
+  server_thread_run(t, worker_dispatch, game_timer);
+  return NULL;
+}